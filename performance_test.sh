@@ -51,6 +51,65 @@ else
     echo "❌ Test failed - no log generated"
 fi
 
+# Fixed-point pipeline of the same build for comparison with the float path
+echo "🔍 Running fixed-point performance test..."
+echo "  Pipeline: --layout fixed"
+echo "  Duration: 10 seconds"
+
+timeout 10s ./build/particle_sim --layout fixed > performance_fixed.log 2>&1
+
+if [ -s performance_fixed.log ]; then
+    extract_metrics performance_fixed.log
+
+    echo "⚖️  Float vs fixed-point (last average per phase, μs):"
+    for phase in "Verlet Integration" "Wall Collisions" "Particle Collisions" "Rendering"; do
+        float_avg=$(grep -A1 "^$phase" performance_baseline.log | grep "Avg:" | tail -1 | awk '{print $2}')
+        fixed_avg=$(grep -A1 "^$phase" performance_fixed.log | grep "Avg:" | tail -1 | awk '{print $2}')
+        echo "  $phase: float ${float_avg:-n/a} | fixed ${fixed_avg:-n/a}"
+    done
+    echo
+else
+    echo "❌ Fixed-point run failed"
+fi
+
+# Page size comparison on the same build
+echo "🔍 Running 4 KB page test (--pages 4k)..."
+timeout 10s ./build/particle_sim --pages 4k > performance_4k.log 2>&1
+
+if [ -s performance_4k.log ]; then
+    echo "⚖️  Huge pages vs 4 KB pages (last value per phase):"
+    for phase in "Verlet Integration" "Particle Collisions"; do
+        thp_avg=$(grep -A1 "^$phase" performance_baseline.log | grep "Avg:" | tail -1 | awk '{print $2}')
+        small_avg=$(grep -A1 "^$phase" performance_4k.log | grep "Avg:" | tail -1 | awk '{print $2}')
+        thp_tlb=$(grep -A6 "^$phase" performance_baseline.log | grep "dTLB Misses:" | tail -1 | awk '{print $3}')
+        small_tlb=$(grep -A6 "^$phase" performance_4k.log | grep "dTLB Misses:" | tail -1 | awk '{print $3}')
+        echo "  $phase: thp ${thp_avg:-n/a}μs, ${thp_tlb:-n/a} dTLB misses | 4k ${small_avg:-n/a}μs, ${small_tlb:-n/a} dTLB misses"
+    done
+    grep "^Arena:" performance_baseline.log | tail -1
+    echo
+else
+    echo "❌ 4 KB page run failed"
+fi
+
+# GL vs software rasterizer on the same replay, both writing video to /dev/null
+echo "🔍 Recording a session for the renderer comparison..."
+timeout 10s ./build/particle_sim --record performance_session.log --seed 42 > /dev/null 2>&1
+
+if [ -s performance_session.log ]; then
+    ./build/particle_sim --replay performance_session.log --video /dev/null --renderer gl > performance_render_gl.log 2>&1
+    ./build/particle_sim --replay performance_session.log --video /dev/null --renderer software > performance_render_sw.log 2>&1
+
+    echo "⚖️  GL vs software rasterizer (last average, μs):"
+    for phase in "Video Frame" "Raster Tiles"; do
+        gl_avg=$(grep -A1 "^$phase" performance_render_gl.log | grep "Avg:" | tail -1 | awk '{print $2}')
+        sw_avg=$(grep -A1 "^$phase" performance_render_sw.log | grep "Avg:" | tail -1 | awk '{print $2}')
+        echo "  $phase: gl ${gl_avg:-n/a} | software ${sw_avg:-n/a}"
+    done
+    echo
+else
+    echo "❌ Session recording failed"
+fi
+
 # Quick memory usage check
 echo "💾 Memory Usage Analysis:"
 if command -v ps &> /dev/null; then
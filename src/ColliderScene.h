@@ -0,0 +1,165 @@
+#pragma once
+#include <cmath>
+#include <fstream>
+#include <initializer_list>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Collider geometry in world units ([-1, 1] on both axes). Static primitives
+// are baked into a SignedDistanceField before the first frame, and particles
+// collide with the surface of their union; kinematic ones move every substep.
+
+// Capsule: every point within thickness / 2 of the segment. A segment with
+// equal end points is a disc.
+struct ColliderSegment {
+    float x0, y0, x1, y1;
+    float thickness;
+};
+
+// Solid polygon, x, y pairs; the last point connects back to the first
+struct ColliderPolygon {
+    std::vector<float> points;
+};
+
+// Capsule moving on a fixed path (KinematicColliders.h): it spins about the
+// pivot at spin radians per second while the pivot swings by
+// travel * sin(2 pi (t / period + phase)). Coordinates are world units at
+// t = 0; a period of 0 means no travel.
+struct KinematicCollider {
+    float x0, y0, x1, y1;
+    float thickness;
+    float pivotX, pivotY;
+    float spin;
+    float travelX, travelY;
+    float period, phase;
+};
+
+struct ColliderScene {
+    std::string name;
+    std::vector<ColliderSegment> segments;
+    std::vector<ColliderPolygon> polygons;
+    std::vector<KinematicCollider> kinematic; // Not baked, moved every substep
+
+    bool empty() const { return !hasStatic() && kinematic.empty(); }
+    bool hasStatic() const { return !segments.empty() || !polygons.empty(); }
+
+    void addSegment(float x0, float y0, float x1, float y1, float thickness) {
+        ColliderSegment segment = { x0, y0, x1, y1, thickness };
+        segments.push_back(segment);
+    }
+
+    void addPolygon(std::initializer_list<float> points) {
+        ColliderPolygon polygon;
+        polygon.points.assign(points.begin(), points.end());
+        polygons.push_back(polygon);
+    }
+
+    void addKinematic(float x0, float y0, float x1, float y1, float thickness, float pivotX, float pivotY, float spin,
+                      float travelX = 0.0f, float travelY = 0.0f, float period = 0.0f, float phase = 0.0f) {
+        KinematicCollider collider = { x0, y0, x1, y1, thickness, pivotX, pivotY, spin, travelX, travelY, period, phase };
+        kinematic.push_back(collider);
+    }
+};
+
+// Built-in scenes; particles spawn along the top of the left wall moving right,
+// so every scene leaves that corner open. Shapes meeting a wall extend past
+// it: an edge lying on the wall would push particles into the wall, and the
+// two would squeeze them through the shape.
+inline bool builtinColliderScene(const std::string& name, ColliderScene& scene) {
+    scene = ColliderScene();
+    scene.name = name;
+    if (name == "box") {
+        return true; // The box walls only
+    }
+    if (name == "funnel") {
+        scene.addSegment(-1.1f, 0.37f, -0.07f, -0.35f, 0.04f);
+        scene.addSegment(1.1f, 0.37f, 0.07f, -0.35f, 0.04f);
+        return true;
+    }
+    if (name == "hopper") {
+        scene.addPolygon({ -1.2f, 0.19f, -0.06f, -0.3f, -0.06f, -0.4f, -1.2f, -0.4f });
+        scene.addPolygon({ 1.2f, 0.19f, 1.2f, -0.4f, 0.06f, -0.4f, 0.06f, -0.3f });
+        scene.addSegment(-0.5f, -0.75f, 0.5f, -0.75f, 0.02f); // Deflector under the outlet
+        return true;
+    }
+    if (name == "pegs") {
+        // Staggered rows of discs, a Galton board
+        for (int row = 0; row < 7; row++) {
+            float y = 0.4f - row * 0.17f;
+            float offset = (row % 2) * 0.1f;
+            for (float x = -0.8f + offset; x < 0.85f; x += 0.2f) {
+                scene.addSegment(x, y, x, y, 0.05f);
+            }
+        }
+        return true;
+    }
+    if (name == "mixer") {
+        // Two crossed blades on each of two rotors in the pile, turning against each other
+        const float rotorX[] = { -0.45f, 0.45f };
+        const float spin[] = { 2.5f, -2.5f };
+        for (int rotor = 0; rotor < 2; rotor++) {
+            float x = rotorX[rotor], y = -0.55f;
+            scene.addKinematic(x - 0.3f, y, x + 0.3f, y, 0.04f, x, y, spin[rotor]);
+            scene.addKinematic(x, y - 0.3f, x, y + 0.3f, 0.04f, x, y, spin[rotor]);
+        }
+        return true;
+    }
+    if (name == "pistons") {
+        // Two plates rising out of the floor half a stroke apart, and a paddle
+        // sweeping the right half; each stroke ends beyond the walls so nothing
+        // is trapped between a collider and a wall
+        scene.addKinematic(-0.9f, -0.83f, -0.55f, -0.83f, 0.04f, -0.725f, -0.83f, 0.0f, 0.0f, 0.22f, 2.0f, 0.0f);
+        scene.addKinematic(-0.45f, -0.83f, -0.1f, -0.83f, 0.04f, -0.275f, -0.83f, 0.0f, 0.0f, 0.22f, 2.0f, 0.5f);
+        scene.addKinematic(0.75f, -1.1f, 0.75f, -0.5f, 0.04f, 0.75f, -0.8f, 0.0f, 0.35f, 0.0f, 3.0f, 0.0f);
+        return true;
+    }
+    return false;
+}
+
+// Scene file, one primitive per line, '#' starts a comment:
+//   segment <x0> <y0> <x1> <y1> <thickness>
+//   polygon <x0> <y0> <x1> <y1> <x2> <y2> ...
+//   kinematic <x0> <y0> <x1> <y1> <thickness> <pivotX> <pivotY> <spin> <travelX> <travelY> <period> <phase>
+inline bool loadColliderSceneFile(const std::string& path, ColliderScene& scene) {
+    std::ifstream file(path.c_str());
+    if (!file) return false;
+    scene = ColliderScene();
+    scene.name = path;
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream fields(line);
+        std::string kind;
+        if (!(fields >> kind)) continue;
+        if (kind == "segment") {
+            ColliderSegment segment;
+            if (!(fields >> segment.x0 >> segment.y0 >> segment.x1 >> segment.y1 >> segment.thickness)) return false;
+            scene.segments.push_back(segment);
+        } else if (kind == "polygon") {
+            ColliderPolygon polygon;
+            float value;
+            while (fields >> value) polygon.points.push_back(value);
+            if (polygon.points.size() < 6 || polygon.points.size() % 2 != 0) return false;
+            scene.polygons.push_back(polygon);
+        } else if (kind == "kinematic") {
+            KinematicCollider collider;
+            if (!(fields >> collider.x0 >> collider.y0 >> collider.x1 >> collider.y1 >> collider.thickness >> collider.pivotX >>
+                  collider.pivotY >> collider.spin >> collider.travelX >> collider.travelY >> collider.period >> collider.phase)) {
+                return false;
+            }
+            scene.kinematic.push_back(collider);
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+// A built-in scene name or a scene file
+inline bool loadColliderScene(const std::string& name, ColliderScene& scene) {
+    return builtinColliderScene(name, scene) || loadColliderSceneFile(name, scene);
+}
+
+inline const char* builtinColliderScenes() { return "box, funnel, hopper, pegs, mixer, pistons"; }
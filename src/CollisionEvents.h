@@ -0,0 +1,168 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// One particle pair pushed apart harder than the stream's impulse threshold
+struct CollisionEvent {
+    int32_t i, j;
+    float impulse; // Pair impulse for unit masses, world units per second
+    float x, y;    // Contact point, world units
+    uint32_t frame;
+};
+
+// Single-producer, single-consumer ring. The producer is one solver thread
+// and never waits: when the consumer has fallen a whole ring behind, the
+// event is dropped and counted. Producer and consumer indices sit on
+// separate cache lines, and the producer only rereads the consumer's index
+// when the ring looks full.
+class CollisionEventRing {
+private:
+    std::vector<CollisionEvent> slots;
+    uint64_t mask;
+    char padBefore[64];
+
+    std::atomic<uint64_t> head; // Written by the producer
+    std::atomic<uint64_t> dropped;
+    uint64_t cachedTail = 0;
+    char padBetween[64];
+
+    std::atomic<uint64_t> tail; // Written by the consumer
+    char padAfter[64];
+
+public:
+    // capacity is rounded up to a power of two
+    explicit CollisionEventRing(int capacity) : head(0), dropped(0), tail(0) {
+        size_t size = 1;
+        while (size < static_cast<size_t>(std::max(capacity, 1))) size <<= 1;
+        slots.resize(size);
+        mask = size - 1;
+    }
+
+    void push(const CollisionEvent& event) {
+        uint64_t position = head.load(std::memory_order_relaxed);
+        if (position - cachedTail > mask) {
+            cachedTail = tail.load(std::memory_order_acquire);
+            if (position - cachedTail > mask) {
+                dropped.store(dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+                return;
+            }
+        }
+        slots[position & mask] = event;
+        head.store(position + 1, std::memory_order_release);
+    }
+
+    // Hands every event pushed so far to consumer(events, count), in at most
+    // two contiguous runs, then frees their slots; returns the event count
+    template <typename Consumer>
+    size_t drain(Consumer& consumer) {
+        uint64_t first = tail.load(std::memory_order_relaxed);
+        uint64_t end = head.load(std::memory_order_acquire);
+        if (first == end) return 0;
+        size_t begin = static_cast<size_t>(first & mask);
+        size_t count = static_cast<size_t>(end - first);
+        size_t run = std::min(count, slots.size() - begin);
+        consumer(&slots[begin], run);
+        if (run < count) consumer(&slots[0], count - run);
+        tail.store(end, std::memory_order_release);
+        return count;
+    }
+
+    uint64_t getPushed() const { return head.load(std::memory_order_relaxed); }
+    uint64_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+// Impacts above a threshold, streamed out of the contact kernel for audio,
+// analytics or wear models without slowing it down. Each solver thread
+// pushes into its own ring, so producers share nothing; one consumer thread
+// polls all rings and hands the events to the consumer callback. Events of
+// one ring arrive in order, across rings only the frame orders them.
+class CollisionEventStream {
+public:
+    typedef std::function<void(const CollisionEvent* events, size_t count)> Consumer;
+
+private:
+    std::vector<std::unique_ptr<CollisionEventRing>> rings;
+    float impulseThreshold;
+    std::chrono::microseconds pollInterval;
+    Consumer consumer;
+    std::thread thread;
+    std::atomic<bool> stopping;
+    std::atomic<uint64_t> consumed;
+    std::atomic<float> maxImpulse;
+    uint64_t reportedPushed = 0, reportedDropped = 0;
+
+    size_t drainAll() {
+        float largest = maxImpulse.load(std::memory_order_relaxed);
+        auto deliver = [&](const CollisionEvent* events, size_t count) {
+            for (size_t k = 0; k < count; k++) largest = std::max(largest, events[k].impulse);
+            if (consumer) consumer(events, count);
+        };
+        size_t count = 0;
+        for (const std::unique_ptr<CollisionEventRing>& ring : rings) count += ring->drain(deliver);
+        maxImpulse.store(largest, std::memory_order_relaxed);
+        consumed.fetch_add(count, std::memory_order_relaxed);
+        return count;
+    }
+
+    void consumerLoop() {
+        while (!stopping.load(std::memory_order_acquire)) {
+            if (drainAll() == 0) std::this_thread::sleep_for(pollInterval);
+        }
+        drainAll(); // Whatever the producers pushed before stopping
+    }
+
+public:
+    // One ring per solver thread; producers is the largest thread count any
+    // pipeline of the run uses
+    CollisionEventStream(int producers, int ringCapacity, float impulseThreshold, std::chrono::microseconds pollInterval)
+        : impulseThreshold(impulseThreshold), pollInterval(pollInterval), stopping(false), consumed(0), maxImpulse(0.0f) {
+        for (int i = 0; i < producers; i++) rings.emplace_back(new CollisionEventRing(ringCapacity));
+    }
+
+    ~CollisionEventStream() { stop(); }
+
+    // Starts the consumer thread; the callback runs on it, so it must not touch simulation state
+    void start(const Consumer& callback) {
+        consumer = callback;
+        thread = std::thread(&CollisionEventStream::consumerLoop, this);
+    }
+
+    // Joins the consumer after it has drained every ring; no step may run afterwards
+    void stop() {
+        if (!thread.joinable()) return;
+        stopping.store(true, std::memory_order_release);
+        thread.join();
+    }
+
+    float getImpulseThreshold() const { return impulseThreshold; }
+
+    // The ring of solver thread index, null past the thread count given at construction
+    CollisionEventRing* ring(int thread) { return thread < static_cast<int>(rings.size()) ? rings[thread].get() : nullptr; }
+
+    // Events and drops since the last call, and how far the consumer is behind now
+    void printStats() {
+        uint64_t pushed = 0, dropped = 0;
+        for (const std::unique_ptr<CollisionEventRing>& ring : rings) {
+            pushed += ring->getPushed();
+            dropped += ring->getDropped();
+        }
+        uint64_t intervalPushed = pushed - reportedPushed;
+        uint64_t intervalDropped = dropped - reportedDropped;
+        reportedPushed = pushed;
+        reportedDropped = dropped;
+        uint64_t total = intervalPushed + intervalDropped;
+        if (total == 0) return;
+        printf("Collision Events: %llu above impulse %g, %llu dropped (%.2f%%), consumer %llu behind, max impulse %.3f\n",
+               static_cast<unsigned long long>(total), impulseThreshold, static_cast<unsigned long long>(intervalDropped),
+               100.0 * intervalDropped / total,
+               static_cast<unsigned long long>(pushed - consumed.load(std::memory_order_relaxed)),
+               maxImpulse.load(std::memory_order_relaxed));
+    }
+};
@@ -0,0 +1,362 @@
+#pragma once
+#include "SpatialGrid.h"
+#include "LocalTimeStepping.h"
+#include "ThreadPool.h"
+#include "PerformanceProfiler.h"
+#include "FixedPoint.h"
+#include "CollisionEvents.h"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+
+enum class CollisionMode {
+    Serial,        // Single-threaded Gauss-Seidel in particle order
+    Parallel,      // Row strips per thread, results depend on the thread count
+    Deterministic  // Fixed 3x3 cell colouring, bitwise identical on any thread count
+};
+
+inline const char* collisionScopeName(CollisionMode mode) {
+    switch (mode) {
+        case CollisionMode::Serial: return "Particle Collisions (Serial)";
+        case CollisionMode::Parallel: return "Particle Collisions (Parallel)";
+        case CollisionMode::Deterministic: return "Particle Collisions (Deterministic)";
+    }
+    return "Particle Collisions";
+}
+
+// One cache line per thread, summed in thread order after every solve,
+// with the thread's event ring (null without an event stream)
+struct alignas(64) CollisionCounters {
+    int checks = 0;
+    int verified = 0;
+    CollisionEventRing* events = nullptr;
+    uint32_t frame = 0;
+
+    void recordEvent(int i, int j, float impulse, float x, float y) {
+        if (!events) return;
+        CollisionEvent event = { i, j, impulse, x, y, frame };
+        events->push(event);
+    }
+};
+
+// Pair response for one position representation. resolve() handles
+// particle i, cached at (x, y), against a list of candidate neighbours.
+template <typename Position> class ContactKernel;
+
+template <>
+class ContactKernel<float> {
+private:
+    float radiusSum, radiusSumSquared, precision;
+    float eventOverlap = std::numeric_limits<float>::max();
+    float impulseScale = 0.0f;
+
+public:
+    ContactKernel(float radius, float precision)
+        : radiusSum(2.0f * radius), radiusSumSquared(4.0f * radius * radius), precision(precision) {}
+
+    // A contact separates the pair by half its overlap within one step, so
+    // for unit masses the impulse is overlap / (4 * stepTime); a threshold
+    // <= 0 turns the events off
+    void setEventThreshold(float impulse, float stepTime) {
+        eventOverlap = impulse > 0.0f ? impulse * 4.0f * stepTime : std::numeric_limits<float>::max();
+        impulseScale = 1.0f / (4.0f * stepTime);
+    }
+
+    template <typename TimeLevels>
+    void resolve(int i, float x, float y, const int* candidates, int count, ArenaVector<float>& positions,
+                 const TimeLevels& timeLevels, int step, CollisionCounters& counters) const {
+        for (int k = 0; k < count; k++) {
+            int j = candidates[k];
+            // Avoid self-collision and checking a pair of stepping particles twice
+            bool jStepping = timeLevels.isActive(j, step);
+            if (i == j || (j < i && jStepping)) continue;
+            counters.checks++;
+
+            float dx = x - positions[j * 2];
+            float dy = y - positions[j * 2 + 1];
+            float distanceSquared = dx * dx + dy * dy;
+
+            if (distanceSquared < radiusSumSquared && distanceSquared > precision) {
+                counters.verified++;
+
+                float distance = sqrtf(distanceSquared);
+                float overlap = radiusSum - distance;
+                float separation = overlap * 0.25f / distance;
+                if (overlap > eventOverlap) counters.recordEvent(i, j, overlap * impulseScale, x - dx * 0.5f, y - dy * 0.5f);
+
+                // A particle skipping this substep stays put, so the stepping one takes the whole correction
+                if (jStepping) {
+                    positions[j * 2] -= dx * separation;
+                    positions[j * 2 + 1] -= dy * separation;
+                } else {
+                    separation *= 2.0f;
+                }
+                positions[i * 2] += dx * separation;
+                positions[i * 2 + 1] += dy * separation;
+            }
+        }
+    }
+};
+
+// Integer pair response. Candidates are first box-tested four at a time with
+// SSE2; the survivors get the exact 64-bit distance test and an integer
+// square root. Since (x, y) is cached and every candidate is a different
+// particle, batching does not change the result.
+template <>
+class ContactKernel<fixed_t> {
+private:
+    fixed_t radiusSum;
+    int64_t radiusSumSquared, precision;
+    int64_t eventOverlap = std::numeric_limits<int64_t>::max();
+    float impulseScale = 0.0f;
+
+    template <typename TimeLevels>
+    void resolveCandidate(int i, int j, fixed_t x, fixed_t y, ArenaVector<fixed_t>& positions,
+                          const TimeLevels& timeLevels, int step, CollisionCounters& counters) const {
+        bool jStepping = timeLevels.isActive(j, step);
+        if (i == j || (j < i && jStepping)) return;
+        counters.checks++;
+
+        int64_t dx = x - positions[j * 2];
+        int64_t dy = y - positions[j * 2 + 1];
+        int64_t distanceSquared = dx * dx + dy * dy;
+
+        if (distanceSquared < radiusSumSquared && distanceSquared > precision) {
+            counters.verified++;
+
+            int64_t distance = isqrt64(distanceSquared);
+            int64_t overlap = radiusSum - distance;
+            if (overlap > eventOverlap) {
+                counters.recordEvent(i, j, toWorld(static_cast<fixed_t>(overlap)) * impulseScale,
+                                     toWorld(static_cast<fixed_t>(x - dx / 2)), toWorld(static_cast<fixed_t>(y - dy / 2)));
+            }
+
+            // Same split as the float kernel: a quarter of the overlap each, or half for i alone
+            if (jStepping) {
+                fixed_t shiftX = static_cast<fixed_t>(dx * overlap / (4 * distance));
+                fixed_t shiftY = static_cast<fixed_t>(dy * overlap / (4 * distance));
+                positions[j * 2] -= shiftX;
+                positions[j * 2 + 1] -= shiftY;
+                positions[i * 2] += shiftX;
+                positions[i * 2 + 1] += shiftY;
+            } else {
+                positions[i * 2] += static_cast<fixed_t>(dx * overlap / (2 * distance));
+                positions[i * 2 + 1] += static_cast<fixed_t>(dy * overlap / (2 * distance));
+            }
+        }
+    }
+
+public:
+    ContactKernel(float radius, float precision)
+        : radiusSum(toFixed(2.0 * radius)),
+          radiusSumSquared(static_cast<int64_t>(radiusSum) * radiusSum),
+          precision(static_cast<int64_t>(precision * FIXED_ONE * FIXED_ONE)) {}
+
+    // Same impulse as the float kernel, compared in fixed point
+    void setEventThreshold(float impulse, float stepTime) {
+        eventOverlap = impulse > 0.0f ? static_cast<int64_t>(toFixed(impulse * 4.0 * stepTime)) : std::numeric_limits<int64_t>::max();
+        impulseScale = 1.0f / (4.0f * stepTime);
+    }
+
+    template <typename TimeLevels>
+    void resolve(int i, fixed_t x, fixed_t y, const int* candidates, int count, ArenaVector<fixed_t>& positions,
+                 const TimeLevels& timeLevels, int step, CollisionCounters& counters) const {
+        int k = 0;
+#if defined(__SSE2__)
+        const __m128i px = _mm_set1_epi32(x);
+        const __m128i py = _mm_set1_epi32(y);
+        const __m128i reach = _mm_set1_epi32(radiusSum);
+        for (; k + 4 <= count; k += 4) {
+            const int* j = candidates + k;
+            __m128i cx = _mm_set_epi32(positions[j[3] * 2], positions[j[2] * 2], positions[j[1] * 2], positions[j[0] * 2]);
+            __m128i cy = _mm_set_epi32(positions[j[3] * 2 + 1], positions[j[2] * 2 + 1],
+                                       positions[j[1] * 2 + 1], positions[j[0] * 2 + 1]);
+            __m128i inside = _mm_and_si128(_mm_cmpgt_epi32(reach, abs32(_mm_sub_epi32(px, cx))),
+                                           _mm_cmpgt_epi32(reach, abs32(_mm_sub_epi32(py, cy))));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(inside));
+            for (int lane = 0; lane < 4; lane++) {
+                if (mask & (1 << lane)) {
+                    resolveCandidate(i, j[lane], x, y, positions, timeLevels, step, counters);
+                }
+            }
+        }
+#endif
+        for (; k < count; k++) {
+            int j = candidates[k];
+            if (std::abs(x - positions[j * 2]) < radiusSum && std::abs(y - positions[j * 2 + 1]) < radiusSum) {
+                resolveCandidate(i, j, x, y, positions, timeLevels, step, counters);
+            }
+        }
+    }
+};
+
+// Particle-particle collision response over a populated SpatialGrid.
+// The parallel modes only run cells concurrently when the 3x3 neighbourhoods
+// they write to cannot overlap, so no pair is ever resolved by two threads.
+// TimeLevels is anything with isActive(particle, step): LocalTimeStepping,
+// or UniformTimeStepping, for which the checks compile away.
+template <typename Position>
+class CollisionSolver {
+private:
+    ContactKernel<Position> kernel;
+    float radiusSum;
+    std::vector<CollisionCounters> threadCounters;
+    ArenaVector<int> nearby;
+    CollisionEventStream* events = nullptr;
+    uint32_t frame = 0;
+
+    // Resolves the stepping particles binned in one cell against their
+    // neighbours. Only cells in the 3x3 block around the bin are visited, so
+    // every write stays inside that block whatever the particle's current position.
+    template <typename TimeLevels>
+    void solveCell(int gx, int gy, const SpatialGrid& grid, ArenaVector<Position>& positions,
+                   const TimeLevels& timeLevels, int step, CollisionCounters& counters) {
+        int width = grid.getWidth();
+        int height = grid.getHeight();
+
+        for (int i : grid.getCell(gy * width + gx)) {
+            if (!timeLevels.isActive(i, step)) continue;
+            Position x = positions[i * 2];
+            Position y = positions[i * 2 + 1];
+            float worldX = toWorld(x);
+            float worldY = toWorld(y);
+
+            int minGridX = std::max(std::max(0, gx - 1), grid.getCellX(worldX - radiusSum));
+            int maxGridX = std::min(std::min(width - 1, gx + 1), grid.getCellX(worldX + radiusSum));
+            int minGridY = std::max(std::max(0, gy - 1), grid.getCellY(worldY - radiusSum));
+            int maxGridY = std::min(std::min(height - 1, gy + 1), grid.getCellY(worldY + radiusSum));
+
+            for (int ny = minGridY; ny <= maxGridY; ny++) {
+                for (int nx = minGridX; nx <= maxGridX; nx++) {
+                    const ArenaVector<int>& cell = grid.getCell(ny * width + nx);
+                    kernel.resolve(i, x, y, cell.data(), static_cast<int>(cell.size()), positions, timeLevels, step, counters);
+                }
+            }
+        }
+    }
+
+    template <typename TimeLevels>
+    void solveSerial(SpatialGrid& grid, ArenaVector<Position>& positions, const TimeLevels& timeLevels,
+                     int step, const ArenaVector<int>& steppingParticles) {
+        CollisionCounters& counters = threadCounters[0];
+        for (int i : steppingParticles) {
+            Position x = positions[i * 2];
+            Position y = positions[i * 2 + 1];
+
+            grid.getNearbyParticles(toWorld(x), toWorld(y), radiusSum, nearby);
+
+            kernel.resolve(i, x, y, nearby.data(), static_cast<int>(nearby.size()), positions, timeLevels, step, counters);
+        }
+    }
+
+    // Splits the grid into horizontal strips of at least two rows and runs the
+    // even strips, then the odd ones, in parallel. Strip boundaries follow the
+    // thread count, and so does the Gauss-Seidel update order. Thread t always
+    // runs strips 2t and 2t + 1, so the same rows stay on the same core.
+    template <typename TimeLevels>
+    void solveParallel(ThreadPool& pool, const SpatialGrid& grid, ArenaVector<Position>& positions,
+                       const TimeLevels& timeLevels, int step) {
+        int width = grid.getWidth();
+        int height = grid.getHeight();
+        int stripCount = std::max(1, std::min(2 * pool.getThreadCount(), height / 2));
+
+        for (int phase = 0; phase < 2; phase++) {
+            pool.forEachThread([&](int thread) {
+                int strip = thread * 2 + phase;
+                if (strip >= stripCount) return;
+                int firstRow = strip * height / stripCount;
+                int lastRow = (strip + 1) * height / stripCount;
+                for (int gy = firstRow; gy < lastRow; gy++) {
+                    for (int gx = 0; gx < width; gx++) {
+                        solveCell(gx, gy, grid, positions, timeLevels, step, threadCounters[thread]);
+                    }
+                }
+            });
+        }
+    }
+
+    // Visits the cells in nine colour passes, (gx % 3, gy % 3). Cells of one
+    // colour are three cells apart, so their 3x3 blocks are disjoint and each
+    // cell sees the same neighbour state no matter which thread runs it or when.
+    // Each thread takes the same contiguous band of rows in every pass.
+    template <typename TimeLevels>
+    void solveDeterministic(ThreadPool& pool, const SpatialGrid& grid, ArenaVector<Position>& positions,
+                            const TimeLevels& timeLevels, int step) {
+        int width = grid.getWidth();
+        int height = grid.getHeight();
+        int threads = pool.getThreadCount();
+
+        for (int colour = 0; colour < 9; colour++) {
+            int colourX = colour % 3;
+            int colourY = colour / 3;
+            int rows = (height - colourY + 2) / 3;
+
+            pool.forEachThread([&](int thread) {
+                int firstRow, lastRow;
+                stableRange(thread, threads, rows, rows, firstRow, lastRow);
+                for (int row = firstRow; row < lastRow; row++) {
+                    int gy = colourY + row * 3;
+                    for (int gx = colourX; gx < width; gx += 3) {
+                        solveCell(gx, gy, grid, positions, timeLevels, step, threadCounters[thread]);
+                    }
+                }
+            });
+        }
+    }
+
+public:
+    CollisionSolver(float radius, float precision)
+        : kernel(radius, precision), radiusSum(2.0f * radius) {}
+
+    // Impacts of the coming frame's solves go to stream, null for none
+    void setEventStream(CollisionEventStream* stream, uint32_t frameNumber, float stepTime) {
+        events = stream;
+        frame = frameNumber;
+        kernel.setEventThreshold(stream ? stream->getImpulseThreshold() : 0.0f, stepTime);
+    }
+
+    template <typename TimeLevels>
+    void solve(CollisionMode mode, ThreadPool& pool, SpatialGrid& grid, ArenaVector<Position>& positions,
+               const TimeLevels& timeLevels, int step, const ArenaVector<int>& steppingParticles) {
+        threadCounters.assign(pool.getThreadCount(), CollisionCounters());
+        if (events) {
+            for (int thread = 0; thread < pool.getThreadCount(); thread++) {
+                threadCounters[thread].events = events->ring(thread);
+                threadCounters[thread].frame = frame;
+            }
+        }
+
+        switch (mode) {
+            case CollisionMode::Serial:
+                solveSerial(grid, positions, timeLevels, step, steppingParticles);
+                break;
+            case CollisionMode::Parallel:
+                solveParallel(pool, grid, positions, timeLevels, step);
+                break;
+            case CollisionMode::Deterministic:
+                solveDeterministic(pool, grid, positions, timeLevels, step);
+                break;
+        }
+
+        // Ordered reduction of the per-thread counters
+        for (const CollisionCounters& counters : threadCounters) {
+            g_profiler.collisionCheck += counters.checks;
+            g_profiler.collisionVerified += counters.verified;
+        }
+    }
+};
+
+// Cost of the deterministic schedule relative to the fastest mode measured so far
+inline void printCollisionModeComparison(PerformanceProfiler& profiler) {
+    double deterministic = profiler.getAverageTime(collisionScopeName(CollisionMode::Deterministic));
+    double serial = profiler.getAverageTime(collisionScopeName(CollisionMode::Serial));
+    double parallel = profiler.getAverageTime(collisionScopeName(CollisionMode::Parallel));
+    double fastest = (serial > 0.0 && (parallel <= 0.0 || serial < parallel)) ? serial : parallel;
+    if (deterministic > 0.0 && fastest > 0.0) {
+        std::cout << "Deterministic Collisions: " << deterministic << "μs vs " << fastest
+                  << "μs fastest non-deterministic (" << (deterministic / fastest - 1.0) * 100.0
+                  << "% cost)" << std::endl;
+    }
+}
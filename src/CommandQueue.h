@@ -0,0 +1,219 @@
+#pragma once
+#include "SimulationConfig.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <sstream>
+#include <string>
+
+enum class CommandType {
+    Gravity,       // gravity <x> <y>
+    Damping,       // damping <d>, the part of the normal speed walls and colliders give back
+    SpawnInterval, // spawn_interval <ms> of simulated time between automatic spawns
+    SpawnCount,    // spawn_count <n> particles per automatic spawn
+    Spawn,         // spawn <n> [<layoutHeight>], one column now
+    Remove,        // remove <x> <y> <radius>, every particle centered inside the circle
+    CollisionMode, // mode serial|parallel|deterministic
+    Substeps       // substeps <n>, a power of two up to UPDATER_PER_FRAME
+};
+
+// One change to a running simulation, plain data so the queue slots never allocate
+struct Command {
+    CommandType type = CommandType::Gravity;
+    float x = 0.0f, y = 0.0f;
+    float value = 0.0f;   // Damping, spawn interval or remove radius
+    int count = 0;        // Spawn count, collision mode or substeps
+    int layoutHeight = 0; // Spawn only, 0 = the consumer's window height
+};
+
+inline const char* collisionModeName(CollisionMode mode) {
+    switch (mode) {
+        case CollisionMode::Serial: return "serial";
+        case CollisionMode::Parallel: return "parallel";
+        case CollisionMode::Deterministic: return "deterministic";
+    }
+    return "unknown";
+}
+
+// Nothing but whitespace and a '#' comment
+inline bool blankCommandLine(const std::string& line) {
+    return line.substr(0, line.find('#')).find_first_not_of(" \t\r\n") == std::string::npos;
+}
+
+// One command per line, '#' starts a comment; false with error set for
+// an unknown command or a value the simulation cannot take
+inline bool parseCommand(const std::string& line, Command& command, std::string& error) {
+    std::istringstream fields(line.substr(0, line.find('#')));
+    std::string name;
+    fields >> name;
+    command = Command();
+    bool valid;
+    if (name == "gravity") {
+        command.type = CommandType::Gravity;
+        valid = static_cast<bool>(fields >> command.x >> command.y);
+    } else if (name == "damping") {
+        command.type = CommandType::Damping;
+        valid = fields >> command.value && command.value >= 0.0f && command.value <= 1.0f;
+    } else if (name == "spawn_interval") {
+        command.type = CommandType::SpawnInterval;
+        valid = fields >> command.value && command.value >= 0.0f;
+    } else if (name == "spawn_count") {
+        command.type = CommandType::SpawnCount;
+        valid = fields >> command.count && command.count >= 0;
+    } else if (name == "spawn") {
+        command.type = CommandType::Spawn;
+        valid = fields >> command.count && command.count >= 0;
+        if (valid && !(fields >> command.layoutHeight)) {
+            fields.clear();
+            command.layoutHeight = 0;
+        }
+        valid = valid && command.layoutHeight >= 0;
+    } else if (name == "remove") {
+        command.type = CommandType::Remove;
+        valid = fields >> command.x >> command.y >> command.value && command.value > 0.0f;
+    } else if (name == "mode") {
+        command.type = CommandType::CollisionMode;
+        std::string mode;
+        valid = false;
+        if (fields >> mode) {
+            for (int candidate = 0; candidate < 3; candidate++) {
+                if (mode != collisionModeName(static_cast<CollisionMode>(candidate))) continue;
+                command.count = candidate;
+                valid = true;
+            }
+        }
+    } else if (name == "substeps") {
+        command.type = CommandType::Substeps;
+        valid = fields >> command.count && command.count >= 1 && command.count <= UPDATER_PER_FRAME &&
+                (command.count & (command.count - 1)) == 0;
+    } else {
+        error = "unknown command '" + name + "'";
+        return false;
+    }
+    std::string extra;
+    if (!valid || fields >> extra) {
+        error = "invalid arguments for " + name;
+        return false;
+    }
+    return true;
+}
+
+// Shortest text that reads back as the same float
+inline std::string formatCommandValue(float value) {
+    char text[32];
+    for (int digits = 6; digits < 9; digits++) {
+        snprintf(text, sizeof(text), "%.*g", digits, value);
+        if (std::strtof(text, nullptr) == value) return text;
+    }
+    snprintf(text, sizeof(text), "%.9g", value);
+    return text;
+}
+
+// The line parseCommand reads back into the same command, floats included
+inline std::string formatCommand(const Command& command) {
+    char text[96];
+    std::string x = formatCommandValue(command.x), y = formatCommandValue(command.y), value = formatCommandValue(command.value);
+    switch (command.type) {
+        case CommandType::Gravity: snprintf(text, sizeof(text), "gravity %s %s", x.c_str(), y.c_str()); break;
+        case CommandType::Damping: snprintf(text, sizeof(text), "damping %s", value.c_str()); break;
+        case CommandType::SpawnInterval: snprintf(text, sizeof(text), "spawn_interval %s", value.c_str()); break;
+        case CommandType::SpawnCount: snprintf(text, sizeof(text), "spawn_count %d", command.count); break;
+        case CommandType::Spawn: snprintf(text, sizeof(text), "spawn %d %d", command.count, command.layoutHeight); break;
+        case CommandType::Remove: snprintf(text, sizeof(text), "remove %s %s %s", x.c_str(), y.c_str(), value.c_str()); break;
+        case CommandType::CollisionMode:
+            snprintf(text, sizeof(text), "mode %s", collisionModeName(static_cast<CollisionMode>(command.count)));
+            break;
+        case CommandType::Substeps: snprintf(text, sizeof(text), "substeps %d", command.count); break;
+    }
+    return text;
+}
+
+// Bounded multi-producer, single-consumer queue of commands. Producers (UI,
+// config watcher, control socket, C API callers) claim a slot with one
+// compare-and-swap on the head and publish it through the slot's sequence
+// number; the simulation thread drains it once per frame, between steps,
+// so nothing inside a step ever waits on a producer. A full queue rejects
+// the command instead of blocking.
+class CommandQueue {
+private:
+    struct Slot {
+        std::atomic<uint64_t> sequence; // position while free, position + 1 once its command is written
+        Command command;
+    };
+
+    std::unique_ptr<Slot[]> slots;
+    uint64_t mask;
+    char padBefore[64];
+
+    std::atomic<uint64_t> head; // Next position to claim, shared by the producers
+    std::atomic<uint64_t> rejected;
+    char padBetween[64];
+
+    uint64_t tail = 0; // Consumer only
+    uint64_t reportedTail = 0, reportedRejected = 0;
+
+public:
+    // capacity is rounded up to a power of two
+    explicit CommandQueue(int capacity) : head(0), rejected(0) {
+        size_t size = 1;
+        while (size < static_cast<size_t>(std::max(capacity, 1))) size <<= 1;
+        slots.reset(new Slot[size]);
+        for (size_t i = 0; i < size; i++) slots[i].sequence.store(i, std::memory_order_relaxed);
+        mask = size - 1;
+    }
+
+    // Any thread; false when the consumer is a whole queue behind
+    bool push(const Command& command) {
+        uint64_t position = head.load(std::memory_order_relaxed);
+        for (;;) {
+            Slot& slot = slots[position & mask];
+            int64_t lag = static_cast<int64_t>(slot.sequence.load(std::memory_order_acquire) - position);
+            if (lag == 0) {
+                if (head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+                    slot.command = command;
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (lag < 0) {
+                rejected.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            } else {
+                position = head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only: hands the published commands to consumer(command)
+    // in queue order and returns how many. Stops at a slot a producer has
+    // claimed but not written yet, which the next drain picks up, and after
+    // one queue's worth so producers cannot keep it going.
+    template <typename Consumer>
+    size_t drain(Consumer& consumer) {
+        size_t count = 0;
+        while (count <= mask) {
+            Slot& slot = slots[tail & mask];
+            if (slot.sequence.load(std::memory_order_acquire) != tail + 1) break;
+            Command command = slot.command;
+            slot.sequence.store(tail + mask + 1, std::memory_order_release);
+            tail++;
+            count++;
+            consumer(command);
+        }
+        return count;
+    }
+
+    // Consumer thread only: commands drained and rejected since the last call
+    void printStats() {
+        uint64_t rejectedTotal = rejected.load(std::memory_order_relaxed);
+        uint64_t drained = tail - reportedTail;
+        uint64_t intervalRejected = rejectedTotal - reportedRejected;
+        reportedTail = tail;
+        reportedRejected = rejectedTotal;
+        if (drained == 0 && intervalRejected == 0) return;
+        printf("Commands: %llu applied, %llu rejected with the queue full\n", static_cast<unsigned long long>(drained),
+               static_cast<unsigned long long>(intervalRejected));
+    }
+};
@@ -0,0 +1,216 @@
+#pragma once
+#include "CommandQueue.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // No such flag on macOS
+#endif
+#endif
+
+// Re-reads a config file of commands whenever its modification time or
+// size changes and queues every line again, so the file holds the parameters a
+// run should have (gravity, damping, spawn rate...) and editing it changes
+// them live. Lines that do not parse are reported and skipped.
+class ConfigWatcher {
+private:
+    CommandQueue& queue;
+    std::string path;
+    std::chrono::milliseconds pollInterval;
+    std::thread thread;
+    std::mutex mutex; // Only for stopping the wait early
+    std::condition_variable wake;
+    bool stopping = false;
+    long long loadedTime = -1, loadedSize = -1;
+
+    // False when the file is missing, for the moment of an editor's rename
+    bool changed() {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0) return false;
+        long long time = static_cast<long long>(status.st_mtime), size = static_cast<long long>(status.st_size);
+        if (time == loadedTime && size == loadedSize) return false;
+        loadedTime = time;
+        loadedSize = size;
+        return true;
+    }
+
+    // False when the file cannot be read
+    bool load() {
+        std::ifstream file(path.c_str());
+        if (!file) return false;
+        std::string line, error;
+        int queued = 0;
+        for (int number = 1; std::getline(file, line); number++) {
+            if (blankCommandLine(line)) continue;
+            Command command;
+            if (!parseCommand(line, command, error)) {
+                std::cout << "Config " << path << ":" << number << ": " << error << std::endl;
+            } else if (!queue.push(command)) {
+                std::cout << "Config " << path << ":" << number << ": command queue full" << std::endl;
+            } else {
+                queued++;
+            }
+        }
+        std::cout << "Config: " << queued << " commands from " << path << std::endl;
+        return true;
+    }
+
+    void watch() {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (!wake.wait_for(lock, pollInterval, [this] { return stopping; })) {
+            if (changed()) load();
+        }
+    }
+
+public:
+    ConfigWatcher(CommandQueue& queue, const std::string& path, std::chrono::milliseconds pollInterval)
+        : queue(queue), path(path), pollInterval(pollInterval) {}
+
+    ~ConfigWatcher() { stop(); }
+
+    // Queues the file once now, so it applies from the first frame, then
+    // watches it; false when it cannot be read
+    bool start() {
+        changed();
+        if (!load()) return false;
+        thread = std::thread(&ConfigWatcher::watch, this);
+        return true;
+    }
+
+    void stop() {
+        if (!thread.joinable()) return;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+};
+
+// Local control socket (a Unix domain socket, owner only): clients write
+// command lines and get "ok" or "error: <reason>" back for each, as soon
+// as it is queued. One thread serves every client with poll().
+class ControlSocket {
+private:
+    CommandQueue& queue;
+    std::string path;
+    int listener = -1;
+    std::thread thread;
+    std::atomic<bool> stopping;
+
+    struct Client {
+        int socket;
+        std::string pending; // Received text after the last complete line
+    };
+
+    std::string handle(const std::string& line) {
+        Command command;
+        std::string error;
+        if (!parseCommand(line, command, error)) return "error: " + error + "\n";
+        if (!queue.push(command)) return "error: command queue full\n";
+        return "ok\n";
+    }
+
+#ifndef _WIN32
+    // False once the client has hung up
+    bool receive(Client& client) {
+        char buffer[512];
+        ssize_t received = recv(client.socket, buffer, sizeof(buffer), 0);
+        if (received <= 0) return false;
+        client.pending.append(buffer, static_cast<size_t>(received));
+        size_t end;
+        while ((end = client.pending.find('\n')) != std::string::npos) {
+            std::string line = client.pending.substr(0, end);
+            client.pending.erase(0, end + 1);
+            if (blankCommandLine(line)) continue;
+            std::string reply = handle(line);
+            if (send(client.socket, reply.data(), reply.size(), MSG_NOSIGNAL) < 0) return false;
+        }
+        return client.pending.size() < 4096; // A line that long is not a command
+    }
+
+    void serve() {
+        std::vector<Client> clients;
+        std::vector<pollfd> sockets;
+        while (!stopping.load(std::memory_order_acquire)) {
+            sockets.clear();
+            sockets.push_back(pollfd{listener, POLLIN, 0});
+            for (const Client& client : clients) sockets.push_back(pollfd{client.socket, POLLIN, 0});
+            if (poll(sockets.data(), sockets.size(), CONTROL_POLL_MS) <= 0) continue;
+
+            for (size_t k = 1; k < sockets.size(); k++) {
+                Client& client = clients[k - 1];
+                if (sockets[k].revents != 0 && !receive(client)) {
+                    close(client.socket);
+                    client.socket = -1;
+                }
+            }
+            for (size_t k = clients.size(); k-- > 0;) {
+                if (clients[k].socket < 0) clients.erase(clients.begin() + k);
+            }
+            if (sockets[0].revents & POLLIN) {
+                int socket = accept(listener, nullptr, nullptr);
+                if (socket >= 0) clients.push_back(Client{socket, std::string()});
+            }
+        }
+        for (const Client& client : clients) close(client.socket);
+    }
+#endif
+
+public:
+    ControlSocket(CommandQueue& queue, const std::string& path) : queue(queue), path(path), stopping(false) {}
+
+    ~ControlSocket() { stop(); }
+
+    // Replaces a stale socket file at path, but nothing else; false after printing why
+    bool start() {
+#ifdef _WIN32
+        std::cout << "Control sockets need a POSIX system" << std::endl;
+        return false;
+#else
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path)) {
+            std::cout << "Control socket path too long: " << path << std::endl;
+            return false;
+        }
+        path.copy(address.sun_path, path.size());
+
+        struct stat status;
+        if (lstat(path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) unlink(path.c_str());
+        listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 || bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+            chmod(path.c_str(), 0600) != 0 || listen(listener, 4) != 0) {
+            std::cout << "Failed to open control socket " << path << std::endl;
+            if (listener >= 0) close(listener);
+            listener = -1;
+            return false;
+        }
+        thread = std::thread(&ControlSocket::serve, this);
+        return true;
+#endif
+    }
+
+    void stop() {
+#ifndef _WIN32
+        if (!thread.joinable()) return;
+        stopping.store(true, std::memory_order_release);
+        thread.join();
+        close(listener);
+        unlink(path.c_str());
+#endif
+    }
+};
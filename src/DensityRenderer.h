@@ -0,0 +1,120 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "SpatialGrid.h"
+#include "SoftwareRasterizer.h"
+#include "ThreadPool.h"
+#include "PerformanceProfiler.h"
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Particle density heatmap: every particle adds one to the pixel under its
+// center, and the counts are tone-mapped logarithmically against the
+// frame's densest pixel. The cost scales with the number of pixels, not
+// with particle overlap, so it stays flat when millions of particles share
+// a pixel.
+//
+// Splatting is split into horizontal bands of pixel rows. A band only walks
+// the spatial grid rows that cover it, one cell of margin on each side for
+// particles that moved after the last collision pass binned them, and only
+// counts the particles whose pixel is in the band, so bands never write the
+// same pixel and need no atomics. Rows are bottom-up like SoftwareRasterizer.
+class DensityRenderer {
+private:
+    int width = 0;
+    int height = 0;
+    int bands = 0;
+    std::vector<uint32_t> counts;
+    std::vector<uint32_t> pixels;
+    std::vector<uint32_t> bandMax;
+    uint32_t ramp[256];
+    uint32_t clearColor;
+    const uint32_t* background = nullptr;
+
+    // Black body style ramp: dark red, orange, yellow, white
+    void buildRamp() {
+        const float stops[][3] = {
+            { 0.5f, 0.0f, 0.1f }, { 0.9f, 0.2f, 0.0f }, { 1.0f, 0.7f, 0.0f }, { 1.0f, 1.0f, 1.0f }
+        };
+        const int segments = 3;
+        for (int i = 0; i < 256; i++) {
+            float t = i / 255.0f * segments;
+            int segment = std::min(static_cast<int>(t), segments - 1);
+            float f = t - segment;
+            const float* a = stops[segment];
+            const float* b = stops[segment + 1];
+            ramp[i] = packRgba8(a[0] + (b[0] - a[0]) * f, a[1] + (b[1] - a[1]) * f, a[2] + (b[2] - a[2]) * f);
+        }
+    }
+
+    int bandBegin(int band) const { return height * band / bands; }
+
+    void splatBand(int band, const SpatialGrid& grid, const float* positions) {
+        int rowBegin = bandBegin(band);
+        int rowEnd = bandBegin(band + 1);
+        std::fill(counts.begin() + static_cast<size_t>(rowBegin) * width,
+                  counts.begin() + static_cast<size_t>(rowEnd) * width, 0u);
+        if (rowBegin == rowEnd) return;
+
+        float rowsPerUnit = height * 0.5f;
+        float columnsPerUnit = width * 0.5f;
+        int cellBegin = std::max(0, grid.getCellY(rowBegin / rowsPerUnit - 1.0f) - 1);
+        int cellEnd = std::min(grid.getHeight() - 1, grid.getCellY(rowEnd / rowsPerUnit - 1.0f) + 1);
+
+        uint32_t densest = 0;
+        for (int cell = cellBegin * grid.getWidth(); cell < (cellEnd + 1) * grid.getWidth(); cell++) {
+            for (int i : grid.getCell(cell)) {
+                float row = std::floor((positions[i * 2 + 1] + 1.0f) * rowsPerUnit);
+                float column = std::floor((positions[i * 2] + 1.0f) * columnsPerUnit);
+                if (row < rowBegin || row >= rowEnd || column < 0.0f || column >= width) continue;
+                uint32_t& count = counts[static_cast<size_t>(row) * width + static_cast<size_t>(column)];
+                count++;
+                densest = std::max(densest, count);
+            }
+        }
+        bandMax[band] = densest;
+    }
+
+    void toneMapBand(int band, float scale) {
+        size_t end = static_cast<size_t>(bandBegin(band + 1)) * width;
+        for (size_t pixel = static_cast<size_t>(bandBegin(band)) * width; pixel < end; pixel++) {
+            uint32_t count = counts[pixel];
+            pixels[pixel] = count == 0 ? (background ? background[pixel] : clearColor) : ramp[std::min(255, static_cast<int>(std::log1p(static_cast<float>(count)) * scale))];
+        }
+    }
+
+public:
+    DensityRenderer() : clearColor(packRgba8(0.1f, 0.1f, 0.1f)) { buildRamp(); }
+
+    void resize(int width, int height) {
+        if (width == this->width && height == this->height) return;
+        this->width = width;
+        this->height = height;
+        counts.assign(static_cast<size_t>(width) * height, 0u);
+        pixels.assign(static_cast<size_t>(width) * height, clearColor);
+    }
+
+    // Shown where no particle is, like SoftwareRasterizer::setBackground
+    void setBackground(const uint32_t* image) { background = image; }
+
+    // grid must hold the particles by their current cells, as the last collision pass left it
+    void render(ThreadPool& pool, const SpatialGrid& grid, const float* positions) {
+        bands = std::min(height, pool.getThreadCount() * DENSITY_BANDS_PER_THREAD);
+        bandMax.assign(bands, 0u);
+        {
+            PROFILE_SCOPE(g_profiler, "Density Splat");
+            pool.parallelFor(bands, [&](int band, int) { splatBand(band, grid, positions); });
+        }
+
+        PROFILE_SCOPE(g_profiler, "Density Tone Map");
+        uint32_t densest = *std::max_element(bandMax.begin(), bandMax.end());
+        // log(1 + n), so lone particles stay visible and the densest pixel is white
+        float scale = 255.0f / std::log1p(static_cast<float>(std::max(densest, 1u)));
+        pool.parallelFor(bands, [&](int band, int) { toneMapBand(band, scale); });
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(pixels.data()); }
+};
@@ -0,0 +1,198 @@
+#pragma once
+#include <cstdint>
+#include <cmath>
+#include <cstdlib>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// 32-bit fixed-point positions: 1.0 == 2^30, so the [-1, 1] world has the
+// same 2^-30 resolution everywhere and overshoot up to +/-2 still fits.
+// The Verlet step, walls and contacts are integer operations, which round
+// the same way on every platform. Float math also writes fixed positions:
+// the static and moving colliders (SignedDistanceField.h,
+// KinematicColliders.h) compute their push-out in float, and field
+// accelerations go through toFixedScaled. Every one of those operations is
+// IEEE-rounded on its own, which the build keeps with -ffp-contract=off;
+// rendering, grid binning and time levels only read the state.
+typedef int32_t fixed_t;
+
+const int FIXED_SHIFT = 30;
+const double FIXED_ONE = static_cast<double>(1 << FIXED_SHIFT);
+
+inline fixed_t toFixed(double value) {
+    return static_cast<fixed_t>(std::floor(value * FIXED_ONE + 0.5));
+}
+
+// value * scale, scale already holding 2^30, rounded to nearest even in
+// float: cheap enough for every particle and substep, and the same on every
+// platform with IEEE floats
+inline void toFixedScaled(float x, float y, float scale, fixed_t* out) {
+#if defined(__SSE2__)
+    __m128i rounded = _mm_cvtps_epi32(_mm_mul_ps(_mm_setr_ps(x, y, 0.0f, 0.0f), _mm_set1_ps(scale)));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), rounded);
+#else
+    out[0] = static_cast<fixed_t>(std::nearbyint(x * scale));
+    out[1] = static_cast<fixed_t>(std::nearbyint(y * scale));
+#endif
+}
+
+inline float fromFixed(fixed_t value) {
+    return static_cast<float>(value) * (1.0f / static_cast<float>(1 << FIXED_SHIFT));
+}
+
+// World-space (float) view of either position representation
+inline float toWorld(float value) { return value; }
+inline float toWorld(fixed_t value) { return fromFixed(value); }
+
+template <typename Position> Position fromWorld(float value);
+template <> inline float fromWorld<float>(float value) { return value; }
+template <> inline fixed_t fromWorld<fixed_t>(float value) { return toFixed(value); }
+
+// Lossless round trip through double for either representation, used to
+// move state from one pipeline to another
+inline double toWorldExact(float value) { return value; }
+inline double toWorldExact(fixed_t value) { return value / FIXED_ONE; }
+
+template <typename Position> Position fromWorldExact(double value);
+template <> inline float fromWorldExact<float>(double value) { return static_cast<float>(value); }
+template <> inline fixed_t fromWorldExact<fixed_t>(double value) { return toFixed(value); }
+
+inline float scaleDisplacement(float displacement, double scale) { return static_cast<float>(displacement * scale); }
+inline fixed_t scaleDisplacement(fixed_t displacement, double scale) {
+    return static_cast<fixed_t>(std::llround(displacement * scale));
+}
+
+// Exact floor(sqrt(value)); the double estimate is correctly rounded by IEEE
+// and then corrected, so the result does not depend on the FPU
+inline int64_t isqrt64(int64_t value) {
+    int64_t root = static_cast<int64_t>(std::sqrt(static_cast<double>(value)));
+    while (root * root > value) root--;
+    while ((root + 1) * (root + 1) <= value) root++;
+    return root;
+}
+
+#if defined(__SSE2__)
+// Low 32 bits of a lane-wise 32-bit product (SSE2 has no _mm_mullo_epi32)
+inline __m128i mullo32(__m128i a, __m128i b) {
+    __m128i even = _mm_mul_epu32(a, b);
+    __m128i odd = _mm_mul_epu32(_mm_srli_si128(a, 4), _mm_srli_si128(b, 4));
+    return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+                              _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128i select32(__m128i mask, __m128i a, __m128i b) {
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline __m128i abs32(__m128i value) {
+    __m128i sign = _mm_srai_epi32(value, 31);
+    return _mm_sub_epi32(_mm_xor_si128(value, sign), sign);
+}
+#endif
+
+// Damped wall response, (displacement * damping) in Q8. The displacement is
+// pre-shifted so the 32-bit product cannot overflow below 0.2 units per substep.
+inline fixed_t dampFixed(fixed_t displacement, int32_t dampingQ8) {
+    return ((displacement >> 4) * dampingQ8) >> 4;
+}
+
+// Verlet step x(n+1) = x(n) + (x(n) - x(n-1)) + a*dt^2 for every particle
+// in [begin, end) whose time level is active, two interleaved particles per
+// SSE2 register. accelerationSteps holds a*dt^2 already converted to fixed
+// point, per particle with a stride of 2, or one x, y pair for all with 0.
+template <typename TimeLevels>
+void integrateFixed(fixed_t* positions, fixed_t* lastPositions, const fixed_t* accelerationSteps, int accelerationStride,
+                    const TimeLevels& timeLevels, int step, int begin, int end) {
+    int i = begin;
+#if defined(__SSE2__)
+    const __m128i uniformAccel = _mm_set_epi32(accelerationSteps[1], accelerationSteps[0], accelerationSteps[1], accelerationSteps[0]);
+    for (; i + 2 <= end; i += 2) {
+        int active0 = timeLevels.isActive(i, step) ? -1 : 0;
+        int active1 = timeLevels.isActive(i + 1, step) ? -1 : 0;
+        if (!(active0 | active1)) continue;
+        __m128i active = _mm_set_epi32(active1, active1, active0, active0);
+
+        __m128i pos = _mm_loadu_si128(reinterpret_cast<const __m128i*>(positions + i * 2));
+        __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lastPositions + i * 2));
+        __m128i accel = accelerationStride == 0
+                            ? uniformAccel
+                            : _mm_loadu_si128(reinterpret_cast<const __m128i*>(accelerationSteps + i * 2));
+        __m128i next = _mm_add_epi32(_mm_add_epi32(pos, _mm_sub_epi32(pos, last)), accel);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(positions + i * 2), select32(active, next, pos));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lastPositions + i * 2), select32(active, pos, last));
+    }
+#endif
+    for (; i < end; i++) {
+        if (!timeLevels.isActive(i, step)) continue;
+        for (int axis = 0; axis < 2; axis++) {
+            fixed_t pos = positions[i * 2 + axis];
+            positions[i * 2 + axis] = pos + (pos - lastPositions[i * 2 + axis]) + accelerationSteps[i * accelerationStride + axis];
+            lastPositions[i * 2 + axis] = pos;
+        }
+    }
+}
+
+// Box walls at [wallMin, wallMax] on both axes for the particles in [begin, end) stepping this substep
+template <typename TimeLevels>
+void applyWallsFixed(fixed_t* positions, fixed_t* lastPositions, const TimeLevels& timeLevels, int step, int begin, int end,
+                     fixed_t wallMin, fixed_t wallMax, int32_t dampingQ8) {
+    int i = begin;
+#if defined(__SSE2__)
+    const __m128i minWall = _mm_set1_epi32(wallMin);
+    const __m128i maxWall = _mm_set1_epi32(wallMax);
+    const __m128i damping = _mm_set1_epi32(dampingQ8);
+    const __m128i ones = _mm_set1_epi32(-1);
+    for (; i + 2 <= end; i += 2) {
+        int active0 = timeLevels.isActive(i, step) ? -1 : 0;
+        int active1 = timeLevels.isActive(i + 1, step) ? -1 : 0;
+        if (!(active0 | active1)) continue;
+        __m128i active = _mm_set_epi32(active1, active1, active0, active0);
+
+        __m128i pos = _mm_loadu_si128(reinterpret_cast<const __m128i*>(positions + i * 2));
+        __m128i last = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lastPositions + i * 2));
+
+        // pos <= wallMin, else pos >= wallMax
+        __m128i low = _mm_andnot_si128(_mm_cmpgt_epi32(pos, minWall), ones);
+        __m128i high = _mm_andnot_si128(low, _mm_andnot_si128(_mm_cmpgt_epi32(maxWall, pos), ones));
+        __m128i hit = _mm_and_si128(_mm_or_si128(low, high), active);
+        if (_mm_movemask_epi8(hit) == 0) continue;
+
+        __m128i wall = select32(low, minWall, maxWall);
+        __m128i displacement = _mm_srai_epi32(_mm_sub_epi32(pos, last), 4);
+        __m128i bounced = _mm_add_epi32(wall, _mm_srai_epi32(mullo32(displacement, damping), 4));
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(lastPositions + i * 2), select32(hit, bounced, last));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(positions + i * 2), select32(hit, wall, pos));
+    }
+#endif
+    for (; i < end; i++) {
+        if (!timeLevels.isActive(i, step)) continue;
+        for (int axis = 0; axis < 2; axis++) {
+            fixed_t pos = positions[i * 2 + axis];
+            if (pos <= wallMin) {
+                lastPositions[i * 2 + axis] = wallMin + dampFixed(pos - lastPositions[i * 2 + axis], dampingQ8);
+                positions[i * 2 + axis] = wallMin;
+            } else if (pos >= wallMax) {
+                lastPositions[i * 2 + axis] = wallMax + dampFixed(pos - lastPositions[i * 2 + axis], dampingQ8);
+                positions[i * 2 + axis] = wallMax;
+            }
+        }
+    }
+}
+
+// Positions for the GL buffer
+inline void convertToWorld(const fixed_t* positions, float* world, int values) {
+    int i = 0;
+#if defined(__SSE2__)
+    const __m128 scale = _mm_set1_ps(1.0f / static_cast<float>(1 << FIXED_SHIFT));
+    for (; i + 4 <= values; i += 4) {
+        __m128i fixed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(positions + i));
+        _mm_storeu_ps(world + i, _mm_mul_ps(_mm_cvtepi32_ps(fixed), scale));
+    }
+#endif
+    for (; i < values; i++) {
+        world[i] = fromFixed(positions[i]);
+    }
+}
@@ -0,0 +1,153 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Spatially varying acceleration (wind, vortices, attractors) sampled on a
+// regular grid over the [-1, 1] world. However many sources went into it,
+// a particle's force is one bilinear lookup in the integrate kernel.
+class ForceField {
+private:
+    int resolution = 0;
+    float inverseSpacing = 0.0f;
+    std::vector<float> vectors; // x, y per node, rows bottom-up
+
+    void allocate(int resolution) {
+        this->resolution = resolution;
+        inverseSpacing = (resolution - 1) / 2.0f;
+        vectors.assign(static_cast<size_t>(resolution) * resolution * 2, 0.0f);
+    }
+
+    // Every node's acceleration from source(x, y, ax, ay)
+    template <typename Source>
+    void generate(int resolution, const Source& source) {
+        allocate(resolution);
+        float spacing = 2.0f / (resolution - 1);
+        for (int row = 0; row < resolution; row++) {
+            for (int column = 0; column < resolution; column++) {
+                float* node = &vectors[(static_cast<size_t>(row) * resolution + column) * 2];
+                source(-1.0f + column * spacing, -1.0f + row * spacing, node[0], node[1]);
+            }
+        }
+    }
+
+    // Swirl around (cx, cy) with a slight pull inwards, softened inside core
+    static void addVortex(float x, float y, float cx, float cy, float strength, float core, float& ax, float& ay) {
+        float dx = x - cx, dy = y - cy;
+        float falloff = strength / (dx * dx + dy * dy + core * core);
+        ax += (-dy - 0.2f * dx) * falloff;
+        ay += (dx - 0.2f * dy) * falloff;
+    }
+
+    static void addAttractor(float x, float y, float cx, float cy, float strength, float core, float& ax, float& ay) {
+        float dx = cx - x, dy = cy - y;
+        float distanceSquared = dx * dx + dy * dy + core * core;
+        float falloff = strength / (distanceSquared * std::sqrt(distanceSquared));
+        ax += dx * falloff;
+        ay += dy * falloff;
+    }
+
+    bool generateBuiltin(const std::string& name, int resolution) {
+        if (name == "wind") {
+            // Blowing right, stronger higher up, with gusts varying along the flow
+            generate(resolution, [](float x, float y, float& ax, float& ay) {
+                ax = 3.0f * (0.6f + 0.4f * y) * (1.0f + 0.3f * std::sin(5.0f * x + 2.0f * y));
+                ay = 0.8f * std::sin(4.0f * x);
+            });
+            return true;
+        }
+        if (name == "vortex") {
+            generate(resolution, [](float x, float y, float& ax, float& ay) {
+                ax = ay = 0.0f;
+                addVortex(x, y, 0.0f, -0.3f, 1.5f, 0.25f, ax, ay);
+            });
+            return true;
+        }
+        if (name == "attractors") {
+            generate(resolution, [](float x, float y, float& ax, float& ay) {
+                ax = ay = 0.0f;
+                addAttractor(x, y, -0.5f, 0.1f, 0.6f, 0.15f, ax, ay);
+                addAttractor(x, y, 0.5f, -0.4f, 0.6f, 0.15f, ax, ay);
+                addVortex(x, y, 0.0f, 0.5f, -0.8f, 0.2f, ax, ay);
+            });
+            return true;
+        }
+        return false;
+    }
+
+    // "<resolution>" then resolution^2 "ax ay" pairs, rows bottom-up from (-1, -1)
+    bool loadFile(const std::string& path) {
+        std::ifstream file(path.c_str());
+        int size = 0;
+        if (!(file >> size) || size < 2 || size > 4096) return false;
+        allocate(size);
+        for (float& value : vectors) {
+            if (!(file >> value)) return false;
+        }
+        return true;
+    }
+
+public:
+    // A built-in field or a field file; "none" leaves the field empty
+    bool load(const std::string& name, int resolution) {
+        vectors.clear();
+        this->resolution = 0;
+        if (name == "none") return true;
+        return generateBuiltin(name, resolution) || loadFile(name);
+    }
+
+    bool isEmpty() const { return vectors.empty(); }
+    int getResolution() const { return resolution; }
+
+    // Bilinear acceleration at (x, y), clamped to the world
+    void sample(float x, float y, float& ax, float& ay) const {
+        float gx = std::min(std::max((x + 1.0f) * inverseSpacing, 0.0f), resolution - 1.001f);
+        float gy = std::min(std::max((y + 1.0f) * inverseSpacing, 0.0f), resolution - 1.001f);
+        int column = static_cast<int>(gx);
+        int row = static_cast<int>(gy);
+        float fx = gx - column;
+        float fy = gy - row;
+        const float* bottom = &vectors[(static_cast<size_t>(row) * resolution + column) * 2];
+        const float* top = bottom + resolution * 2;
+#if defined(__SSE2__)
+        // Two horizontally neighbouring nodes fill one register, x and y of both
+        __m128 lower = _mm_loadu_ps(bottom);
+        __m128 upper = _mm_loadu_ps(top);
+        __m128 columns = _mm_add_ps(lower, _mm_mul_ps(_mm_sub_ps(upper, lower), _mm_set1_ps(fy)));
+        __m128 right = _mm_movehl_ps(columns, columns);
+        __m128 result = _mm_add_ps(columns, _mm_mul_ps(_mm_sub_ps(right, columns), _mm_set1_ps(fx)));
+        ax = _mm_cvtss_f32(result);
+        ay = _mm_cvtss_f32(_mm_shuffle_ps(result, result, _MM_SHUFFLE(1, 1, 1, 1)));
+#else
+        float columns[4];
+        for (int k = 0; k < 4; k++) columns[k] = bottom[k] + (top[k] - bottom[k]) * fy;
+        ax = columns[0] + (columns[2] - columns[0]) * fx;
+        ay = columns[1] + (columns[3] - columns[1]) * fx;
+#endif
+    }
+};
+
+inline const char* builtinForceFields() { return "none, wind, vortex, attractors"; }
+
+// The scene-wide acceleration: gravity, which the keys change, plus the
+// optional field. Passed by value into the integrator every frame.
+struct Acceleration {
+    float gravityX = 0.0f;
+    float gravityY = -5.0f; // Increased for visibility
+    const ForceField* field = nullptr;
+
+    void at(float x, float y, float& ax, float& ay) const {
+        ax = gravityX;
+        ay = gravityY;
+        if (!field) return;
+        float fx, fy;
+        field->sample(x, y, fx, fy);
+        ax += fx;
+        ay += fy;
+    }
+};
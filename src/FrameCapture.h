@@ -0,0 +1,205 @@
+#pragma once
+#include "glad/glad.h"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+// Raw video stream of RGBA frames, as YUV4MPEG2 (4:2:0, BT.601 limited range)
+// when the path ends in .y4m and as concatenated binary PPMs otherwise.
+// "-" writes Y4M to stdout for piping into an encoder (see reserveStdout).
+class VideoWriter {
+private:
+    FILE* file = nullptr;
+    bool y4m = true;
+    int width = 0;
+    int height = 0;
+    std::vector<uint8_t> buffer;
+    long long frames = 0;
+
+    static bool endsWith(const std::string& text, const std::string& suffix) {
+        return text.size() >= suffix.size() && text.compare(text.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    // GL rows are bottom-up, video rows top-down
+    const uint8_t* pixel(const uint8_t* rgba, int x, int y) const {
+        return rgba + (static_cast<size_t>(height - 1 - y) * width + x) * 4;
+    }
+
+    void writeY4m(const uint8_t* rgba) {
+        int chromaWidth = width / 2;
+        int chromaHeight = height / 2;
+        uint8_t* luma = buffer.data();
+        uint8_t* cb = luma + width * height;
+        uint8_t* cr = cb + chromaWidth * chromaHeight;
+
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const uint8_t* p = pixel(rgba, x, y);
+                luma[y * width + x] = static_cast<uint8_t>(((66 * p[0] + 129 * p[1] + 25 * p[2] + 128) >> 8) + 16);
+            }
+        }
+        // Chroma of each 2x2 block from its average color
+        for (int y = 0; y < chromaHeight; y++) {
+            for (int x = 0; x < chromaWidth; x++) {
+                int r = 0, g = 0, b = 0;
+                for (int dy = 0; dy < 2; dy++) {
+                    for (int dx = 0; dx < 2; dx++) {
+                        const uint8_t* p = pixel(rgba, x * 2 + dx, y * 2 + dy);
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                    }
+                }
+                r = (r + 2) / 4;
+                g = (g + 2) / 4;
+                b = (b + 2) / 4;
+                cb[y * chromaWidth + x] = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+                cr[y * chromaWidth + x] = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+            }
+        }
+        fputs("FRAME\n", file);
+        fwrite(buffer.data(), 1, buffer.size(), file);
+    }
+
+    void writePpm(const uint8_t* rgba) {
+        uint8_t* out = buffer.data();
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const uint8_t* p = pixel(rgba, x, y);
+                *out++ = p[0];
+                *out++ = p[1];
+                *out++ = p[2];
+            }
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        fwrite(buffer.data(), 1, buffer.size(), file);
+    }
+
+    static int& stdoutVideoFd() {
+        static int fd = -1;
+        return fd;
+    }
+
+public:
+    ~VideoWriter() { close(); }
+
+    // Keeps the real stdout for the video and sends everything the process
+    // prints to stderr instead. Call before the first output.
+    static void reserveStdout() {
+        if (stdoutVideoFd() >= 0) return;
+        fflush(stdout);
+        stdoutVideoFd() = dup(STDOUT_FILENO);
+        dup2(STDERR_FILENO, STDOUT_FILENO);
+    }
+
+    // Y4M needs even dimensions for its 4:2:0 chroma planes
+    bool open(const std::string& path, int width, int height, int fps) {
+        this->width = width;
+        this->height = height;
+        if (path == "-") {
+            reserveStdout();
+            file = fdopen(stdoutVideoFd(), "wb");
+        } else {
+            y4m = endsWith(path, ".y4m");
+            file = fopen(path.c_str(), "wb");
+        }
+        if (!file) return false;
+
+        if (y4m) {
+            if (width % 2 != 0 || height % 2 != 0) return false;
+            fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg\n", width, height, fps);
+            buffer.resize(static_cast<size_t>(width) * height * 3 / 2);
+        } else {
+            buffer.resize(static_cast<size_t>(width) * height * 3);
+        }
+        return true;
+    }
+
+    const char* formatName() const { return y4m ? "y4m" : "ppm"; }
+    long long getFrameCount() const { return frames; }
+
+    // One frame as read back by glReadPixels(GL_RGBA, GL_UNSIGNED_BYTE)
+    void writeFrame(const uint8_t* rgba) {
+        if (y4m) writeY4m(rgba);
+        else writePpm(rgba);
+        frames++;
+    }
+
+    void close() {
+        if (file) fclose(file);
+        file = nullptr;
+    }
+};
+
+// Reads the bound framebuffer back through a ring of pixel buffer objects.
+// glReadPixels into a PBO returns immediately; a frame is mapped and written
+// CAPTURE_BUFFERS - 1 frames later, once its fence has normally signaled.
+// Only when the GPU falls that far behind does the capture wait (counted
+// as a stall).
+class PboFrameCapture {
+private:
+    static const int CAPTURE_BUFFERS = 3;
+
+    VideoWriter& writer;
+    int width;
+    int height;
+    GLuint buffers[CAPTURE_BUFFERS];
+    GLsync fences[CAPTURE_BUFFERS];
+    int next = 0;
+    int stalls = 0;
+
+    void writeOut(int slot) {
+        if (!fences[slot]) return;
+        if (glClientWaitSync(fences[slot], 0, 0) == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+            glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[slot]);
+        const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, static_cast<GLsizeiptr>(width) * height * 4, GL_MAP_READ_BIT);
+        if (pixels) writer.writeFrame(static_cast<const uint8_t*>(pixels));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+public:
+    PboFrameCapture(VideoWriter& writer, int width, int height) : writer(writer), width(width), height(height) {
+        glGenBuffers(CAPTURE_BUFFERS, buffers);
+        for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[i]);
+            glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(width) * height * 4, nullptr, GL_STREAM_READ);
+            fences[i] = nullptr;
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    ~PboFrameCapture() {
+        finish();
+        glDeleteBuffers(CAPTURE_BUFFERS, buffers);
+    }
+
+    int getStalls() const { return stalls; }
+
+    // After the frame is drawn
+    void capture() {
+        // The slot about to be reused holds the oldest frame
+        writeOut(next);
+
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, buffers[next]);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        fences[next] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        next = (next + 1) % CAPTURE_BUFFERS;
+    }
+
+    // Writes the frames still in flight, oldest first
+    void finish() {
+        for (int i = 0; i < CAPTURE_BUFFERS; i++) {
+            writeOut((next + i) % CAPTURE_BUFFERS);
+        }
+    }
+};
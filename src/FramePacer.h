@@ -0,0 +1,123 @@
+#pragma once
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/mman.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+// Holds the render loop to a fixed frame period. Each frame ends at an
+// absolute deadline one period after the previous one, so oversleeping one
+// frame is taken back from the next instead of drifting. The thread sleeps
+// until spinMargin before the deadline and busy-waits the rest, which hides
+// the scheduler's wake-up granularity.
+class FramePacer {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Clock::duration period;
+    Clock::duration spinMargin;
+    Clock::time_point deadline;
+    Clock::time_point lastPresent;
+    bool started = false;
+
+    // Present-to-present intervals since the last report, in ms
+    std::vector<double> intervals;
+    int missedDeadlines = 0;      // The frame's work ran past its deadline
+    int totalMissedDeadlines = 0;
+    int lateWakeups = 0;          // The sleep overshot the spin margin
+
+public:
+    FramePacer(float targetFps, std::chrono::microseconds spinMargin)
+        : period(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / targetFps))),
+          spinMargin(spinMargin) {}
+
+    // Call right after the buffer swap: waits for the frame's deadline and
+    // records the interval since the previous frame was presented
+    void waitForNextFrame() {
+        Clock::time_point now = Clock::now();
+        if (!started) {
+            started = true;
+            deadline = now + period;
+            lastPresent = now;
+            return;
+        }
+
+        if (now > deadline) {
+            // Missed the frame; restart the schedule rather than bursting to catch up
+            missedDeadlines++;
+            totalMissedDeadlines++;
+            deadline = now;
+        } else {
+            Clock::time_point wake = deadline - spinMargin;
+            if (now < wake) std::this_thread::sleep_until(wake);
+            while (Clock::now() < deadline) {
+                // Spin the last stretch
+            }
+        }
+
+        Clock::time_point present = Clock::now();
+        if (present - deadline > spinMargin) lateWakeups++;
+        intervals.push_back(std::chrono::duration<double, std::milli>(present - lastPresent).count());
+        lastPresent = present;
+        deadline += period;
+    }
+
+    // Interval statistics since the last call; jitter is the standard deviation
+    void printStats() {
+        if (intervals.empty()) return;
+        double target = std::chrono::duration<double, std::milli>(period).count();
+        double sum = 0.0;
+        for (double interval : intervals) sum += interval;
+        double mean = sum / intervals.size();
+        double variance = 0.0;
+        for (double interval : intervals) variance += (interval - mean) * (interval - mean);
+        double jitter = std::sqrt(variance / intervals.size());
+
+        std::vector<double> sorted = intervals;
+        std::sort(sorted.begin(), sorted.end());
+        double p99 = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+
+        printf("Frame Pacing: target %.2f ms, mean %.2f ms, jitter %.3f ms, min %.2f / p99 %.2f / max %.2f ms, "
+               "missed %d (%d total), late wake-ups %d\n",
+               target, mean, jitter, sorted.front(), p99, sorted.back(), missedDeadlines, totalMissedDeadlines,
+               lateWakeups);
+        intervals.clear();
+        missedDeadlines = 0;
+        lateWakeups = 0;
+    }
+};
+
+// SCHED_FIFO for the calling thread and locked memory, for dedicated (kiosk)
+// machines. Both need CAP_SYS_NICE / CAP_IPC_LOCK or matching rlimits; a
+// failure is reported and the process carries on with normal scheduling.
+inline void enableRealtimeScheduling(int priority) {
+#ifdef __linux__
+    sched_param param;
+    param.sched_priority = priority;
+    if (sched_setscheduler(0, SCHED_FIFO, &param) != 0) {
+        std::cout << "SCHED_FIFO unavailable: " << std::strerror(errno) << std::endl;
+    } else {
+        std::cout << "Scheduling: SCHED_FIFO priority " << priority << std::endl;
+    }
+
+    // Lock pages as they fault in, so the reserved arena is not populated up front
+    int flags = MCL_CURRENT | MCL_FUTURE;
+#ifdef MCL_ONFAULT
+    flags |= MCL_ONFAULT;
+#endif
+    if (mlockall(flags) != 0) {
+        std::cout << "mlockall failed: " << std::strerror(errno) << std::endl;
+    }
+#else
+    (void)priority;
+    std::cout << "Real-time scheduling is only supported on Linux" << std::endl;
+#endif
+}
@@ -0,0 +1,103 @@
+#pragma once
+#include "glad/glad.h"
+#include "PerformanceProfiler.h"
+#include <string>
+#include <vector>
+
+// GPU execution time of named render scopes, recorded in the profiler next
+// to the CPU timers. Each scope is a pair of GL_TIMESTAMP queries (unlike
+// GL_TIME_ELAPSED they may nest and can bracket the buffer swap). Queries of
+// a frame sit in a ring of GPU_TIMER_FRAMES slots and are read back when
+// the slot comes round again, by which time the GPU has normally finished
+// them, so the CPU never waits. A slot that is still pending is dropped.
+class GpuTimer {
+private:
+    static const int GPU_TIMER_FRAMES = 4;
+
+    struct Scope {
+        std::string name;
+        GLuint begin = 0;
+        GLuint end = 0;
+    };
+
+    struct FrameSlot {
+        std::vector<Scope> scopes;   // Query pairs, reused frame to frame
+        int used = 0;                // Scopes issued this round
+    };
+
+    PerformanceProfiler& profiler;
+    FrameSlot slots[GPU_TIMER_FRAMES];
+    int current = 0;
+    bool supported = false;
+    int droppedFrames = 0;
+
+    void collect(FrameSlot& slot) {
+        if (slot.used == 0) return;
+        // Timestamps complete in order, so the last end query decides for the whole frame
+        GLint available = 0;
+        glGetQueryObjectiv(slot.scopes[slot.used - 1].end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            droppedFrames++;
+        } else {
+            for (int i = 0; i < slot.used; i++) {
+                GLuint64 begin = 0, end = 0;
+                glGetQueryObjectui64v(slot.scopes[i].begin, GL_QUERY_RESULT, &begin);
+                glGetQueryObjectui64v(slot.scopes[i].end, GL_QUERY_RESULT, &end);
+                profiler.recordTime(slot.scopes[i].name, (end - begin) / 1000.0);
+            }
+        }
+        slot.used = 0;
+    }
+
+public:
+    explicit GpuTimer(PerformanceProfiler& profiler) : profiler(profiler) {
+        GLint bits = 0;
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+        supported = bits > 0;
+    }
+
+    bool isSupported() const { return supported; }
+    int getDroppedFrames() const { return droppedFrames; }
+
+    // Once per frame before the first scope: reads back the frame issued
+    // GPU_TIMER_FRAMES ago and reuses its queries
+    void beginFrame() {
+        if (!supported) return;
+        current = (current + 1) % GPU_TIMER_FRAMES;
+        collect(slots[current]);
+    }
+
+    // Returns the scope index for end()
+    int begin(const char* name) {
+        if (!supported) return -1;
+        FrameSlot& slot = slots[current];
+        if (slot.used == static_cast<int>(slot.scopes.size())) {
+            Scope scope;
+            glGenQueries(1, &scope.begin);
+            glGenQueries(1, &scope.end);
+            slot.scopes.push_back(scope);
+        }
+        Scope& scope = slot.scopes[slot.used];
+        scope.name = name;
+        glQueryCounter(scope.begin, GL_TIMESTAMP);
+        return slot.used++;
+    }
+
+    void end(int scope) {
+        if (scope < 0) return;
+        glQueryCounter(slots[current].scopes[scope].end, GL_TIMESTAMP);
+    }
+};
+
+// RAII GPU scope, the counterpart of PROFILE_SCOPE
+class ScopedGpuTimer {
+private:
+    GpuTimer& timer;
+    int scope;
+
+public:
+    ScopedGpuTimer(GpuTimer& timer, const char* name) : timer(timer), scope(timer.begin(name)) {}
+    ~ScopedGpuTimer() { timer.end(scope); }
+};
+
+#define PROFILE_GPU_SCOPE(gpuTimer, name) ScopedGpuTimer gpuScope(gpuTimer, name)
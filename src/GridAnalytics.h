@@ -0,0 +1,178 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+// Coarse fields of one frame, per block of cellsPerBin x cellsPerBin broad
+// phase cells. Velocities are in world units per second, unit masses.
+struct AnalyticsCell {
+    int count = 0;             // Particles binned in the block
+    float packing = 0.0f;      // Fraction of the block's area covered by particles
+    float velocityX = 0.0f;    // Mean velocity
+    float velocityY = 0.0f;
+    float temperature = 0.0f;  // Kinetic temperature, mean |v - mean v|^2 / 2 (two degrees of freedom)
+    float coordination = 0.0f; // Mean number of touching neighbours
+};
+
+// In-situ analytics: density, mean velocity, kinetic temperature and
+// coordination number computed from the particles where the last collision
+// pass binned them, instead of from dumped trajectories. Each task reduces
+// one row of blocks and is the only writer of its cells and its row totals,
+// so the pass runs on the simulation's pool between steps with no atomics;
+// the scene-wide means are the row totals added up in row order.
+class GridAnalytics {
+private:
+    // Sums of one block or one row of blocks
+    struct Moments {
+        double count = 0.0, velocityX = 0.0, velocityY = 0.0, speedSquared = 0.0, contacts = 0.0;
+        double heat = 0.0; // Rows only: block temperatures times their counts
+    };
+
+    int cellsPerBin;
+    float contactDistance;
+    int width = 0, height = 0;
+    float binSize = 0.0f;
+    long long frame = -1;
+    std::vector<AnalyticsCell> cells;
+    std::vector<Moments> rowTotals;
+    AnalyticsCell scene; // Every particle as one block, except for the temperature
+
+    static void finish(const Moments& moments, float area, AnalyticsCell& cell) {
+        cell.count = static_cast<int>(moments.count);
+        if (moments.count == 0.0) {
+            cell = AnalyticsCell();
+            return;
+        }
+        double meanX = moments.velocityX / moments.count;
+        double meanY = moments.velocityY / moments.count;
+        cell.packing = static_cast<float>(moments.count * 3.14159265 * radius * radius / area);
+        cell.velocityX = static_cast<float>(meanX);
+        cell.velocityY = static_cast<float>(meanY);
+        cell.temperature = static_cast<float>(std::max(0.0, moments.speedSquared / moments.count - meanX * meanX - meanY * meanY) * 0.5);
+        cell.coordination = static_cast<float>(moments.contacts / moments.count);
+    }
+
+    // Touching neighbours of particle i from the 3x3 broad phase cells around (gx, gy)
+    int countContacts(int i, int gx, int gy, const SpatialGrid& grid, const float* positions) const {
+        float x = positions[i * 2], y = positions[i * 2 + 1];
+        float reachSquared = contactDistance * contactDistance;
+        int contacts = 0;
+        for (int ny = std::max(0, gy - 1); ny <= std::min(grid.getHeight() - 1, gy + 1); ny++) {
+            for (int nx = std::max(0, gx - 1); nx <= std::min(grid.getWidth() - 1, gx + 1); nx++) {
+                for (int j : grid.getCell(ny * grid.getWidth() + nx)) {
+                    float dx = x - positions[j * 2], dy = y - positions[j * 2 + 1];
+                    if (j != i && dx * dx + dy * dy < reachSquared) contacts++;
+                }
+            }
+        }
+        return contacts;
+    }
+
+    void reduceRow(int row, const SpatialGrid& grid, const float* positions, const float* lastPositions, float inverseStep) {
+        Moments total;
+        int firstY = row * cellsPerBin;
+        int lastY = std::min(grid.getHeight(), firstY + cellsPerBin);
+        // The last row and column of blocks reach past the world, only the part inside counts
+        float binHeight = std::min(grid.getMaxY(), grid.getMinY() + lastY * grid.getCellSize()) - (grid.getMinY() + firstY * grid.getCellSize());
+        for (int column = 0; column < width; column++) {
+            int firstX = column * cellsPerBin;
+            int lastX = std::min(grid.getWidth(), firstX + cellsPerBin);
+            Moments block;
+            for (int gy = firstY; gy < lastY; gy++) {
+                for (int gx = firstX; gx < lastX; gx++) {
+                    for (int i : grid.getCell(gy * grid.getWidth() + gx)) {
+                        double vx = (positions[i * 2] - lastPositions[i * 2]) * inverseStep;
+                        double vy = (positions[i * 2 + 1] - lastPositions[i * 2 + 1]) * inverseStep;
+                        block.count += 1.0;
+                        block.velocityX += vx;
+                        block.velocityY += vy;
+                        block.speedSquared += vx * vx + vy * vy;
+                        block.contacts += countContacts(i, gx, gy, grid, positions);
+                    }
+                }
+            }
+            AnalyticsCell& cell = cells[static_cast<size_t>(row) * width + column];
+            float binWidth = std::min(grid.getMaxX(), grid.getMinX() + lastX * grid.getCellSize()) - (grid.getMinX() + firstX * grid.getCellSize());
+            finish(block, binWidth * binHeight, cell);
+            total.heat += cell.temperature * block.count;
+            total.count += block.count;
+            total.velocityX += block.velocityX;
+            total.velocityY += block.velocityY;
+            total.speedSquared += block.speedSquared;
+            total.contacts += block.contacts;
+        }
+        rowTotals[row] = total;
+    }
+
+public:
+    // contactDistance: center distance below which two particles count as touching
+    GridAnalytics(int cellsPerBin, float contactDistance) : cellsPerBin(std::max(1, cellsPerBin)), contactDistance(contactDistance) {}
+
+    // positions and lastPositions in world units, one step apart; grid holds
+    // the particles by the cells the last collision pass put them in
+    void compute(ThreadPool& pool, const SpatialGrid& grid, const float* positions, const float* lastPositions,
+                 float stepTime, long long frameNumber) {
+        width = (grid.getWidth() + cellsPerBin - 1) / cellsPerBin;
+        height = (grid.getHeight() + cellsPerBin - 1) / cellsPerBin;
+        binSize = grid.getCellSize() * cellsPerBin;
+        cells.resize(static_cast<size_t>(width) * height);
+        rowTotals.resize(height);
+        frame = frameNumber;
+
+        float inverseStep = 1.0f / stepTime;
+        pool.parallelFor(height, [&](int row, int) { reduceRow(row, grid, positions, lastPositions, inverseStep); });
+
+        Moments total;
+        for (const Moments& row : rowTotals) {
+            total.count += row.count;
+            total.velocityX += row.velocityX;
+            total.velocityY += row.velocityY;
+            total.speedSquared += row.speedSquared;
+            total.contacts += row.contacts;
+            total.heat += row.heat;
+        }
+        // The scene's velocity spread is mostly bulk flow, so its temperature is the blocks' mean
+        finish(total, (grid.getMaxX() - grid.getMinX()) * (grid.getMaxY() - grid.getMinY()), scene);
+        if (total.count > 0.0) scene.temperature = static_cast<float>(total.heat / total.count);
+    }
+
+    bool isEmpty() const { return frame < 0; }
+    long long getFrame() const { return frame; }
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    // World units per block side; block (0, 0) starts at the grid's minimum corner
+    float getBinSize() const { return binSize; }
+    // Row-major, bottom row first
+    const std::vector<AnalyticsCell>& getCells() const { return cells; }
+    const AnalyticsCell& getScene() const { return scene; }
+
+    // One snapshot: a "# frame" line, then one line per occupied block
+    void write(FILE* file) const {
+        fprintf(file, "# frame %lld blocks %d %d size %.5f\n", frame, width, height, binSize);
+        for (int row = 0; row < height; row++) {
+            for (int column = 0; column < width; column++) {
+                const AnalyticsCell& cell = cells[static_cast<size_t>(row) * width + column];
+                if (cell.count == 0) continue;
+                fprintf(file, "%d %d %d %.4f %.4f %.4f %.5f %.3f\n", column, row, cell.count, cell.packing, cell.velocityX,
+                        cell.velocityY, cell.temperature, cell.coordination);
+            }
+        }
+    }
+
+    void printStats() const {
+        if (isEmpty()) return;
+        float densest = 0.0f, hottest = 0.0f;
+        int occupied = 0;
+        for (const AnalyticsCell& cell : cells) {
+            densest = std::max(densest, cell.packing);
+            hottest = std::max(hottest, cell.temperature);
+            occupied += cell.count > 0;
+        }
+        printf("Analytics: frame %lld, %d of %d blocks occupied, packing up to %.2f, temperature %.4f (up to %.4f), "
+               "coordination %.2f\n", frame, occupied, width * height, densest, scene.temperature, hottest, scene.coordination);
+    }
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+// One perf_event hardware counter for the thread that opens it and, with
+// inherit, every thread it (or they) start afterwards: reads include the
+// live child threads, so a counter opened before the worker pools exist
+// covers the whole parallel phase. Opening fails
+// without PMU access (VMs, containers, perf_event_paranoid > 2); the counter
+// then stays unavailable and the profiler leaves its column out.
+class HardwareCounter {
+private:
+    int fd = -1;
+
+public:
+    HardwareCounter() {}
+    HardwareCounter(const HardwareCounter&) = delete;
+    HardwareCounter& operator=(const HardwareCounter&) = delete;
+
+    ~HardwareCounter() {
+        if (fd >= 0) close(fd);
+    }
+
+    bool open(uint32_t type, uint64_t config, bool inherit) {
+#ifdef __linux__
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = inherit ? 1 : 0;
+        fd = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)type;
+        (void)config;
+        (void)inherit;
+#endif
+        return fd >= 0;
+    }
+
+    bool isAvailable() const { return fd >= 0; }
+
+    uint64_t read() const {
+        uint64_t value = 0;
+        if (fd >= 0 && ::read(fd, &value, sizeof(value)) != static_cast<ssize_t>(sizeof(value))) {
+            value = 0;
+        }
+        return value;
+    }
+};
+
+// Data TLB misses on loads, the cost huge pages are meant to cut, of the
+// calling thread and every thread started after it (the pool workers)
+inline bool openTlbMissCounter(HardwareCounter& counter) {
+#ifdef __linux__
+    return counter.open(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                            (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), true);
+#else
+    return counter.open(0, 0, true);
+#endif
+}
@@ -0,0 +1,241 @@
+#pragma once
+#include "glad/glad.h"
+#include "SimulationConfig.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// One segment of the HUD's stacked frame cost bar, listed below it
+struct HudSegment {
+    const char* label;
+    double ms;
+    float r, g, b;
+};
+
+// In-window performance overlay: a scrolling frame-time graph against the
+// frame period, the frame's cost stacked by phase, and text lines. Like
+// the particles it is a single instanced draw, here of a unit quad with one
+// instance per rectangle: the panel, every graph column and bar segment,
+// and every lit pixel of a 3x5 pixel font. Positions are window pixels from
+// the top-left corner.
+class Hud {
+private:
+    static const int FONT_SCALE = 2;    // Window pixels per font pixel
+    static const int LINE_HEIGHT = 6 * FONT_SCALE + 2;
+    static const int GRAPH_HEIGHT = 60; // Two frame periods
+    static const int MARGIN = 8;
+
+    GLuint program = 0, VAO = 0, quadVBO = 0, instanceVBO = 0;
+    GLint viewportLocation = -1;
+    size_t instanceCapacity = 0;
+    std::vector<float> instances;       // x, y, width, height, r, g, b, a
+    std::vector<float> frameTimes;      // Ring of the last HUD_GRAPH_FRAMES frames, ms
+    int nextFrame = 0;
+    bool visible = HUD_VISIBLE;
+    unsigned char glyphs[128][5];       // Rows of 3 bits, the left pixel in bit 2
+
+    void addGlyphs(const char* characters, const unsigned char rows[][5]) {
+        for (int i = 0; characters[i]; i++) {
+            std::copy(rows[i], rows[i] + 5, glyphs[static_cast<unsigned char>(characters[i])]);
+        }
+    }
+
+    void buildFont() {
+        static const unsigned char digits[][5] = {
+            {7,5,5,5,7}, {2,6,2,2,7}, {7,1,7,4,7}, {7,1,7,1,7}, {5,5,7,1,1},
+            {7,4,7,1,7}, {7,4,7,5,7}, {7,1,1,1,1}, {7,5,7,5,7}, {7,5,7,1,7}
+        };
+        static const unsigned char letters[][5] = {
+            {2,5,7,5,5}, {6,5,6,5,6}, {3,4,4,4,3}, {6,5,5,5,6}, {7,4,6,4,7}, {7,4,6,4,4}, {3,4,5,5,3},
+            {5,5,7,5,5}, {7,2,2,2,7}, {1,1,1,5,2}, {5,5,6,5,5}, {4,4,4,4,7}, {5,7,7,5,5}, {6,5,5,5,5},
+            {2,5,5,5,2}, {6,5,6,4,4}, {2,5,5,6,3}, {6,5,6,5,5}, {3,4,2,1,6}, {7,2,2,2,2}, {5,5,5,5,7},
+            {5,5,5,5,2}, {5,5,7,7,5}, {5,5,2,5,5}, {5,5,2,2,2}, {7,1,2,4,7}
+        };
+        static const unsigned char symbols[][5] = {
+            {0,0,0,0,2}, {0,2,0,2,0}, {1,1,2,4,4}, {0,0,7,0,0}, {5,1,2,4,5}, {1,2,2,2,1}, {4,2,2,2,4}
+        };
+        for (auto& glyph : glyphs) std::fill(glyph, glyph + 5, 0);
+        addGlyphs("0123456789", digits);
+        addGlyphs("ABCDEFGHIJKLMNOPQRSTUVWXYZ", letters);
+        addGlyphs(".:/-%()", symbols);
+    }
+
+    void rect(float x, float y, float width, float height, float r, float g, float b, float a = 1.0f) {
+        const float values[] = { x, y, width, height, r, g, b, a };
+        instances.insert(instances.end(), values, values + 8);
+    }
+
+    // Upper case only, lower case letters are mapped to it
+    void text(float x, float y, const std::string& line, float r, float g, float b) {
+        for (char c : line) {
+            unsigned char glyph = static_cast<unsigned char>(std::toupper(static_cast<unsigned char>(c)));
+            if (glyph < 128) {
+                for (int row = 0; row < 5; row++) {
+                    for (int column = 0; column < 3; column++) {
+                        if (glyphs[glyph][row] & (4 >> column)) {
+                            rect(x + column * FONT_SCALE, y + row * FONT_SCALE, FONT_SCALE, FONT_SCALE, r, g, b);
+                        }
+                    }
+                }
+            }
+            x += 4 * FONT_SCALE;
+        }
+    }
+
+    static GLuint compile(GLenum type, const char* source) {
+        GLuint shader = glCreateShader(type);
+        glShaderSource(shader, 1, &source, NULL);
+        glCompileShader(shader);
+        int success;
+        char infoLog[512];
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(shader, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::HUD::COMPILATION_FAILED\n" << infoLog << std::endl;
+        }
+        return shader;
+    }
+
+    void createProgram() {
+        const char* vertexSource = "#version 330 core\n"
+            "layout (location = 0) in vec2 corner;\n"
+            "layout (location = 1) in vec4 rect;\n"
+            "layout (location = 2) in vec4 color;\n"
+            "uniform vec2 viewport;\n"
+            "out vec4 fragColor;\n"
+            "void main()\n"
+            "{\n"
+            "   vec2 pixel = rect.xy + corner * rect.zw;\n"
+            "   gl_Position = vec4(pixel.x / viewport.x * 2.0 - 1.0, 1.0 - pixel.y / viewport.y * 2.0, 0.0, 1.0);\n"
+            "   fragColor = color;\n"
+            "}\0";
+        const char* fragmentSource = "#version 330 core\n"
+            "in vec4 fragColor;\n"
+            "out vec4 FragColor;\n"
+            "void main()\n"
+            "{\n"
+            "   FragColor = fragColor;\n"
+            "}\0";
+
+        GLuint vertexShader = compile(GL_VERTEX_SHADER, vertexSource);
+        GLuint fragmentShader = compile(GL_FRAGMENT_SHADER, fragmentSource);
+        program = glCreateProgram();
+        glAttachShader(program, vertexShader);
+        glAttachShader(program, fragmentShader);
+        glLinkProgram(program);
+        int success;
+        char infoLog[512];
+        glGetProgramiv(program, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(program, 512, NULL, infoLog);
+            std::cout << "ERROR::SHADER::HUD::LINKING_FAILED\n" << infoLog << std::endl;
+        }
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+        viewportLocation = glGetUniformLocation(program, "viewport");
+    }
+
+public:
+    // Needs a current GL context
+    Hud() : frameTimes(HUD_GRAPH_FRAMES, 0.0f) {
+        buildFont();
+        createProgram();
+
+        const float corners[] = { 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 1.0f, 1.0f, 1.0f };
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &quadVBO);
+        glGenBuffers(1, &instanceVBO);
+        glBindVertexArray(VAO);
+
+        glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(0);
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribDivisor(1, 1);
+        glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(4 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribDivisor(2, 1);
+        glBindVertexArray(0);
+    }
+
+    bool isVisible() const { return visible; }
+    void toggle() { visible = !visible; }
+
+    float getAverageFrameTime() const {
+        float sum = 0.0f;
+        for (float ms : frameTimes) sum += ms;
+        return sum / HUD_GRAPH_FRAMES;
+    }
+
+    // Every frame, also while hidden, so the graph is complete when it is shown
+    void addFrameTime(float ms) {
+        frameTimes[nextFrame] = ms;
+        nextFrame = (nextFrame + 1) % HUD_GRAPH_FRAMES;
+    }
+
+    // Segments stack from the left, with the full bar width being one frame period
+    void draw(int width, int height, const std::vector<HudSegment>& segments, const std::vector<std::string>& lines) {
+        const float period = 1000.0f / TARGET_FPS;
+        const float graphWidth = HUD_GRAPH_FRAMES * 2.0f;
+        float x = MARGIN * 2.0f;
+        float y = MARGIN * 2.0f;
+        float panelHeight = GRAPH_HEIGHT + MARGIN * 3 + 10 + LINE_HEIGHT * (segments.size() + lines.size()) + MARGIN;
+
+        instances.clear();
+        rect(MARGIN, MARGIN, graphWidth + MARGIN * 2, panelHeight, 0.0f, 0.0f, 0.0f, 0.6f);
+
+        // Frame times, oldest on the left; green within the period, red beyond
+        rect(x, y + GRAPH_HEIGHT / 2, graphWidth, 1.0f, 0.6f, 0.6f, 0.6f);
+        for (int i = 0; i < HUD_GRAPH_FRAMES; i++) {
+            float ms = frameTimes[(nextFrame + i) % HUD_GRAPH_FRAMES];
+            float barHeight = std::min(ms / (2.0f * period), 1.0f) * GRAPH_HEIGHT;
+            bool late = ms > period * 1.05f;
+            rect(x + i * 2.0f, y + GRAPH_HEIGHT - barHeight, 2.0f, barHeight, late ? 1.0f : 0.3f, late ? 0.3f : 0.9f, 0.3f);
+        }
+        y += GRAPH_HEIGHT + MARGIN;
+
+        // Frame cost by phase
+        float segmentX = x;
+        for (const HudSegment& segment : segments) {
+            float segmentWidth = std::min(static_cast<float>(segment.ms) / period * graphWidth, x + graphWidth - segmentX);
+            if (segmentWidth > 0.0f) rect(segmentX, y, segmentWidth, 10.0f, segment.r, segment.g, segment.b);
+            segmentX += std::max(segmentWidth, 0.0f);
+        }
+        y += 10 + MARGIN;
+
+        char value[32];
+        for (const HudSegment& segment : segments) {
+            snprintf(value, sizeof(value), "%.2f MS", segment.ms);
+            text(x, y, std::string(segment.label) + " " + value, segment.r, segment.g, segment.b);
+            y += LINE_HEIGHT;
+        }
+        for (const std::string& line : lines) {
+            text(x, y, line, 0.9f, 0.9f, 0.9f);
+            y += LINE_HEIGHT;
+        }
+
+        // Grows the instance buffer as lines get longer, otherwise only updates it
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (instances.size() > instanceCapacity) {
+            instanceCapacity = instances.size() * 2;
+            glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+        }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(float), instances.data());
+
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glUseProgram(program);
+        glUniform2f(viewportLocation, static_cast<float>(width), static_cast<float>(height));
+        glBindVertexArray(VAO);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances.size() / 8));
+        glBindVertexArray(0);
+        glDisable(GL_BLEND);
+    }
+};
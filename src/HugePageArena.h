@@ -0,0 +1,229 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <sys/mman.h>
+
+// Backing for the arena: 4 KB pages, transparent huge pages requested with
+// madvise, or explicit MAP_HUGETLB pages from the kernel's huge page pool.
+enum class PageMode {
+    Small,
+    Transparent,
+    Explicit
+};
+
+inline const char* pageModeName(PageMode mode) {
+    switch (mode) {
+        case PageMode::Small: return "4k";
+        case PageMode::Transparent: return "thp";
+        case PageMode::Explicit: return "hugetlb";
+    }
+    return "unknown";
+}
+
+inline bool parsePageMode(const std::string& name, PageMode& mode) {
+    for (PageMode candidate : { PageMode::Small, PageMode::Transparent, PageMode::Explicit }) {
+        if (name == pageModeName(candidate)) {
+            mode = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const size_t ARENA_ALIGNMENT = 64;                 // One cache line
+const size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+const size_t ARENA_DEFAULT_BYTES = 64u << 20;      // Used if nothing is reserved before the first allocation
+
+const int ARENA_SIZE_CLASSES = 4 + 4 * 40;        // 64..256 bytes, then four classes per power of two
+
+// Bump allocator over one reserved, 2 MB aligned region, with a free list
+// per size class so freed blocks are handed out again. Sizes are rounded up
+// to their class (64-byte steps up to 256 bytes, then quarter powers of two,
+// at most 25% slack), so a block always goes back to the list it can serve.
+// The particle arrays are reserved up front and grid cells keep their
+// capacity between substeps, so a running simulation stops allocating after
+// its first frames and the hot arrays end up packed into a few huge pages;
+// the arrays of simulations that are destroyed or replaced (C API, pipeline
+// switches) are reused by the next ones instead of running the region out.
+class HugePageArena {
+private:
+    char* base = nullptr;
+    size_t capacity = 0;
+    std::atomic<size_t> used;     // Bump offset: bytes ever handed out from the region
+    std::atomic<size_t> released; // Bytes waiting on the free lists
+
+    std::mutex freeMutex;
+    void* freeLists[ARENA_SIZE_CLASSES] = {};       // Singly linked through each block's first word
+    std::atomic<int> freeCounts[ARENA_SIZE_CLASSES]; // Lets allocate skip the lock for an empty class
+    PageMode mode = PageMode::Small;
+
+    // Class of a size already rounded to ARENA_ALIGNMENT, and the size it is rounded up to
+    static int sizeClass(size_t size, size_t& classSize) {
+        if (size <= 4 * ARENA_ALIGNMENT) {
+            classSize = size;
+            return static_cast<int>(size / ARENA_ALIGNMENT) - 1;
+        }
+        int exponent = 8; // 2^exponent < size <= 2^(exponent + 1)
+        while ((size - 1) >> (exponent + 1)) exponent++;
+        size_t step = static_cast<size_t>(1) << (exponent - 2);
+        classSize = (size + step - 1) & ~(step - 1);
+        return 4 + (exponent - 8) * 4 + static_cast<int>((classSize >> (exponent - 2)) - 5);
+    }
+
+public:
+    HugePageArena() : used(0), released(0) {
+        for (std::atomic<int>& count : freeCounts) count.store(0);
+    }
+
+    ~HugePageArena() {
+        if (base) munmap(base, capacity);
+    }
+
+    // Reserves address space only, pages are backed when first touched.
+    // Explicit huge pages fall back to transparent ones if the pool is too small.
+    bool reserve(size_t bytes, PageMode requested) {
+        if (base) return false; // Earlier allocations would dangle
+        capacity = (bytes + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        mode = requested;
+
+        if (mode == PageMode::Explicit) {
+#ifdef MAP_HUGETLB
+            void* region = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if (region != MAP_FAILED) {
+                base = static_cast<char*>(region);
+                return true;
+            }
+#endif
+            std::cout << "Arena: no explicit huge pages available, using transparent huge pages" << std::endl;
+            mode = PageMode::Transparent;
+        }
+
+        // Over-reserve by one huge page so the region can start on a 2 MB boundary
+        size_t mapped = capacity + HUGE_PAGE_SIZE;
+        void* region = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (region == MAP_FAILED) {
+            capacity = 0;
+            return false;
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(region);
+        uintptr_t aligned = (start + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+        if (aligned > start) munmap(region, aligned - start);
+        if (aligned + capacity < start + mapped) munmap(reinterpret_cast<void*>(aligned + capacity), start + mapped - aligned - capacity);
+        base = reinterpret_cast<char*>(aligned);
+
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        // 4k mode opts out explicitly, so it stays a baseline when THP is set to "always"
+        madvise(base, capacity, mode == PageMode::Transparent ? MADV_HUGEPAGE : MADV_NOHUGEPAGE);
+#else
+        mode = PageMode::Small;
+#endif
+        return true;
+    }
+
+    // 64-byte aligned, thread safe; a freed block of the same class first
+    void* allocate(size_t bytes) {
+        if (!base && !reserve(ARENA_DEFAULT_BYTES, PageMode::Transparent)) throw std::bad_alloc();
+        if (bytes > capacity) throw std::bad_alloc();
+        size_t size;
+        int index = sizeClass((std::max<size_t>(bytes, 1) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1), size);
+        if (freeCounts[index].load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> lock(freeMutex);
+            void* block = freeLists[index];
+            if (block) {
+                freeLists[index] = *static_cast<void**>(block);
+                freeCounts[index]--;
+                released -= size;
+                return block;
+            }
+        }
+        // The offset only moves once the block fits, so a failed request leaves the region as it was
+        size_t offset = used.load();
+        do {
+            if (offset + size > capacity) throw std::bad_alloc();
+        } while (!used.compare_exchange_weak(offset, offset + size));
+        return base + offset;
+    }
+
+    void deallocate(void* pointer, size_t bytes) {
+        if (!pointer) return;
+        size_t size;
+        int index = sizeClass((std::max<size_t>(bytes, 1) + ARENA_ALIGNMENT - 1) & ~(ARENA_ALIGNMENT - 1), size);
+        std::lock_guard<std::mutex> lock(freeMutex);
+        *static_cast<void**>(pointer) = freeLists[index];
+        freeLists[index] = pointer;
+        freeCounts[index]++;
+        released += size;
+    }
+
+    PageMode getPageMode() const { return mode; }
+
+    // Granularity the kernel places memory at: a huge page when they are
+    // requested (thp may still fall back to 4 KB pages, never the reverse)
+    size_t getPageSize() const { return mode == PageMode::Small ? 4096 : HUGE_PAGE_SIZE; }
+    // Bytes held by live allocations
+    size_t getUsedBytes() const { return used.load() - released.load(); }
+
+    // Huge page backed bytes of the region, from /proc/self/smaps (Linux only)
+    size_t hugePageBytes() const {
+        std::ifstream smaps("/proc/self/smaps");
+        std::string line;
+        bool inRegion = false;
+        while (std::getline(smaps, line)) {
+            uintptr_t start = 0, end = 0;
+            char dash = 0;
+            std::istringstream header(line);
+            if (header >> std::hex >> start >> dash >> end && dash == '-') {
+                inRegion = start <= reinterpret_cast<uintptr_t>(base) && reinterpret_cast<uintptr_t>(base) < end;
+            } else if (inRegion && line.compare(0, 14, "AnonHugePages:") == 0) {
+                return std::stoull(line.substr(14)) * 1024;
+            }
+        }
+        return mode == PageMode::Explicit ? used.load() : 0;
+    }
+
+    void printStats() const {
+        std::cout << "Arena: " << getUsedBytes() / 1024 << " KB used (" << released.load() / 1024
+                  << " KB free for reuse), " << capacity / (1024 * 1024) << " MB reserved, pages: " << pageModeName(mode)
+                  << ", huge page backed: " << hugePageBytes() / 1024 << " KB" << std::endl;
+    }
+};
+
+// Arena shared by all particle and grid storage
+inline HugePageArena& particleArena() {
+    static HugePageArena arena;
+    return arena;
+}
+
+template <typename T>
+struct ArenaAllocator {
+    typedef T value_type;
+
+    ArenaAllocator() {}
+    template <typename U> ArenaAllocator(const ArenaAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(particleArena().allocate(count * sizeof(T)));
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        particleArena().deallocate(pointer, count * sizeof(T));
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return true; }
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>&, const ArenaAllocator<U>&) { return false; }
+
+template <typename T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
@@ -0,0 +1,117 @@
+#pragma once
+#include "glad/glad.h"
+#include <chrono>
+#include <deque>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+
+// Input-to-photon latency: from a key press to the moment the GPU has
+// finished the buffer swap of the first frame that shows its effect.
+//
+// Presses are timestamped in the GLFW key callback, i.e. when glfwPollEvents
+// delivers them. processInput reads the keys after a frame is rendered, so
+// their effect is first drawn by the next frame. After that frame's swap a
+// GL_TIMESTAMP query is issued; its result is read back without blocking a
+// few frames later and converted to the CPU clock with a calibrated offset.
+// Scanout on the display adds up to one refresh interval on top.
+class InputLatencyTracker {
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct PendingFrame {
+        long long frame;                    // Presented frame that first shows the input
+        std::vector<Clock::time_point> presses;
+        GLuint query = 0;                   // Timestamp after its swap, 0 until presented
+    };
+
+    std::vector<Clock::time_point> unconsumed; // Pressed since the last processInput
+    std::deque<PendingFrame> pending;
+    std::vector<GLuint> freeQueries;            // Recycled, released with the GL context
+    long long presentedFrames = 0;
+
+    // CPU steady_clock ns minus GPU timestamp ns
+    long long gpuToCpuOffset = 0;
+    bool calibrated = false;
+
+    std::vector<double> latencies; // ms, since the last report
+
+    static long long cpuNanoseconds(Clock::time_point time) {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(time.time_since_epoch()).count();
+    }
+
+    void calibrate() {
+        GLint64 gpuNow = 0;
+        glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+        gpuToCpuOffset = cpuNanoseconds(Clock::now()) - gpuNow;
+        calibrated = true;
+    }
+
+public:
+    // From the GLFW key callback, for presses only (not repeats or releases)
+    void keyPressed() { unconsumed.push_back(Clock::now()); }
+
+    // After processInput: the presses so far take effect in the next presented frame
+    void inputConsumed() {
+        if (unconsumed.empty()) return;
+        PendingFrame frame;
+        frame.frame = presentedFrames + 1;
+        frame.presses.swap(unconsumed);
+        pending.push_back(frame);
+    }
+
+    // Right after glfwSwapBuffers
+    void framePresented() {
+        if (!calibrated) calibrate();
+        for (PendingFrame& frame : pending) {
+            if (frame.frame != presentedFrames || frame.query != 0) continue;
+            if (freeQueries.empty()) {
+                GLuint query;
+                glGenQueries(1, &query);
+                freeQueries.push_back(query);
+            }
+            frame.query = freeQueries.back();
+            freeQueries.pop_back();
+            glQueryCounter(frame.query, GL_TIMESTAMP);
+        }
+        presentedFrames++;
+        collect();
+    }
+
+    // Reads back every finished query, oldest first, without waiting on the GPU
+    void collect() {
+        while (!pending.empty() && pending.front().query != 0) {
+            PendingFrame& frame = pending.front();
+            GLint available = 0;
+            glGetQueryObjectiv(frame.query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) break;
+
+            GLuint64 gpuTime = 0;
+            glGetQueryObjectui64v(frame.query, GL_QUERY_RESULT, &gpuTime);
+            long long photon = static_cast<long long>(gpuTime) + gpuToCpuOffset;
+            for (Clock::time_point press : frame.presses) {
+                latencies.push_back((photon - cpuNanoseconds(press)) / 1.0e6);
+            }
+            freeQueries.push_back(frame.query);
+            pending.pop_front();
+        }
+    }
+
+    void printStats() {
+        // The GPU clock drifts against the CPU one, so the offset is renewed every report
+        calibrate();
+        if (latencies.empty()) {
+            printf("Input Latency: no key presses\n");
+            return;
+        }
+        std::vector<double> sorted = latencies;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (double latency : sorted) sum += latency;
+        size_t last = sorted.size() - 1;
+        printf("Input Latency: %zu presses, mean %.2f ms, p50 %.2f / p95 %.2f / p99 %.2f / max %.2f ms\n",
+               sorted.size(), sum / sorted.size(), sorted[last * 50 / 100], sorted[last * 95 / 100],
+               sorted[last * 99 / 100], sorted[last]);
+        latencies.clear();
+    }
+};
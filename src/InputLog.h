@@ -0,0 +1,135 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Lockstep input log. The header stores everything a run depends on besides
+// input (seed, worker threads, pipeline, collider scene, force field); then one line per simulated
+// frame holds the spawn before its physics step, the collision mode and
+// substep count used for the step, the keys applied after it and the
+// resulting state checksum:
+//
+//   <frame> <spawnCount> <spawnLayoutHeight> <mode> <substeps> <keys> <checksum>
+//
+// Commands (CommandQueue.h) applied at the start of a frame, before its
+// spawn, come first on lines of their own:
+//
+//   > <command>
+//
+// Replaying the lines in order reproduces the session and the checksums show
+// the first frame where a replay diverges.
+struct InputLogEntry {
+    long long frame = 0;
+    int spawnCount = 0;
+    int spawnLayoutHeight = 0;
+    int collisionMode = 0;
+    int substeps = 0;
+    int keys = 0; // INPUT_KEY_* bits
+    uint64_t checksum = 0;
+    std::vector<std::string> commands; // formatCommand text, in the order they were applied
+};
+
+const int INPUT_KEY_REVERSE_GRAVITY = 1 << 0;
+const int INPUT_KEY_PUSH_LEFT = 1 << 1;
+
+const char* const INPUT_LOG_MAGIC = "particle_sim_input_log";
+const int INPUT_LOG_VERSION = 6;
+const int INPUT_LOG_OLDEST_VERSION = 3; // Version 3 logs have no scene line and ran in the plain box
+const int INPUT_LOG_SCENE_GRAVITY_VERSION = 5; // Keys change one scene-wide gravity from here on, not each particle's
+
+struct InputLogHeader {
+    uint32_t seed = 0;
+    int threads = 0;
+    std::string layout;     // Position layout, "float" or "fixed"
+    std::string integrator; // "multirate" or "uniform"
+    std::string scene = "box"; // Built-in collider scene or scene file (ColliderScene.h), no spaces
+    std::string field = "none"; // Built-in force field or field file (ForceField.h), no spaces
+    int version = INPUT_LOG_VERSION; // Of a log that was read
+};
+
+class InputRecorder {
+private:
+    std::ofstream file;
+
+public:
+    bool open(const std::string& path, const InputLogHeader& header) {
+        file.open(path.c_str());
+        if (!file) return false;
+        file << INPUT_LOG_MAGIC << " " << INPUT_LOG_VERSION << "\n";
+        file << "seed " << header.seed << "\n";
+        file << "threads " << header.threads << "\n";
+        file << "layout " << header.layout << "\n";
+        file << "integrator " << header.integrator << "\n";
+        file << "scene " << header.scene << "\n";
+        file << "field " << header.field << "\n";
+        return true;
+    }
+
+    bool isOpen() const { return file.is_open(); }
+
+    void record(const InputLogEntry& entry) {
+        for (const std::string& command : entry.commands) file << "> " << command << "\n";
+        char checksum[17];
+        snprintf(checksum, sizeof(checksum), "%016llx", static_cast<unsigned long long>(entry.checksum));
+        file << entry.frame << " " << entry.spawnCount << " " << entry.spawnLayoutHeight << " "
+             << entry.collisionMode << " " << entry.substeps << " " << entry.keys << " " << checksum << "\n";
+    }
+
+    // Called periodically so a crashed session still leaves most of its frames on disk
+    void flush() { file.flush(); }
+};
+
+class InputLogReader {
+private:
+    std::ifstream file;
+
+public:
+    bool open(const std::string& path, InputLogHeader& header) {
+        file.open(path.c_str());
+        if (!file) return false;
+
+        std::string magic;
+        int version = 0;
+        file >> magic >> version;
+        if (magic != INPUT_LOG_MAGIC || version < INPUT_LOG_OLDEST_VERSION || version > INPUT_LOG_VERSION) return false;
+        header.version = version;
+
+        std::string key;
+        file >> key >> header.seed;
+        if (key != "seed") return false;
+        file >> key >> header.threads;
+        if (key != "threads") return false;
+        file >> key >> header.layout;
+        if (key != "layout") return false;
+        file >> key >> header.integrator;
+        if (key != "integrator") return false;
+        if (version >= 4) {
+            file >> key >> header.scene;
+            if (key != "scene") return false;
+        }
+        if (version >= 5) {
+            file >> key >> header.field;
+            if (key != "field") return false;
+        }
+        return static_cast<bool>(file);
+    }
+
+    bool next(InputLogEntry& entry) {
+        entry.commands.clear();
+        std::string checksum;
+        while (file >> std::ws && file.peek() == '>') {
+            std::string command;
+            file.get();
+            std::getline(file >> std::ws, command);
+            entry.commands.push_back(command);
+        }
+        if (!(file >> entry.frame >> entry.spawnCount >> entry.spawnLayoutHeight
+                   >> entry.collisionMode >> entry.substeps >> entry.keys >> checksum)) {
+            return false;
+        }
+        entry.checksum = std::stoull(checksum, nullptr, 16);
+        return true;
+    }
+};
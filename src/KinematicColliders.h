@@ -0,0 +1,379 @@
+#pragma once
+#include "ColliderScene.h"
+#include "SimulationConfig.h"
+#include "SpatialGrid.h"
+#include "ThreadPool.h"
+#include "FixedPoint.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Axis-aligned box in world units
+struct ColliderBounds {
+    float minX, minY, maxX, maxY;
+
+    static ColliderBounds around(float x, float y, float margin) {
+        ColliderBounds bounds = { x - margin, y - margin, x + margin, y + margin };
+        return bounds;
+    }
+
+    void add(const ColliderBounds& other) {
+        minX = std::min(minX, other.minX);
+        minY = std::min(minY, other.minY);
+        maxX = std::max(maxX, other.maxX);
+        maxY = std::max(maxY, other.maxY);
+    }
+
+    bool overlaps(const ColliderBounds& other) const {
+        return minX <= other.maxX && other.minX <= maxX && minY <= other.maxY && other.minY <= maxY;
+    }
+};
+
+// Moving capsules (paddles, mixer blades, pistons) that push particles.
+// Their poses are a function of simulated time, so a replay or a pipeline
+// switch reproduces them from the frame count alone. Every substep the
+// capsules' swept bounds (from the previous pose to the current one) go into
+// a small BVH, rebuilt from scratch, and only the particles of grid cells
+// that overlap a leaf are tested against its capsules: the cost follows the
+// particles near the colliders rather than particles times colliders.
+class KinematicColliders {
+private:
+    // Capsule end points at one instant
+    struct Pose {
+        float x0, y0, x1, y1;
+    };
+
+    // Leaves hold colliders [first, first + count) of order; inner nodes have count 0
+    struct BvhNode {
+        ColliderBounds bounds;
+        int first, count;
+        int left, right;
+    };
+
+    static const int LEAF_SIZE = 2;
+
+    std::vector<KinematicCollider> colliders;
+    std::vector<Pose> poses, lastPoses;   // This substep and the one before
+    std::vector<ColliderBounds> sweptBounds;
+    std::vector<int> order;
+    std::vector<BvhNode> nodes;
+    std::vector<int> rowTests;            // Particle-capsule tests per grid row of the last pass
+
+    long long particleTests = 0;
+    long long bruteForceTests = 0;        // Every particle against every collider
+    long long passes = 0;
+
+    static Pose poseAt(const KinematicCollider& collider, double time) {
+        const double twoPi = 6.283185307179586;
+        double angle = std::fmod(collider.spin * time, twoPi);
+        double swing = collider.period > 0.0f ? std::sin(twoPi * std::fmod(time / collider.period + collider.phase, 1.0)) : 0.0;
+        float c = static_cast<float>(std::cos(angle));
+        float s = static_cast<float>(std::sin(angle));
+        float centerX = collider.pivotX + collider.travelX * static_cast<float>(swing);
+        float centerY = collider.pivotY + collider.travelY * static_cast<float>(swing);
+        float ax = collider.x0 - collider.pivotX, ay = collider.y0 - collider.pivotY;
+        float bx = collider.x1 - collider.pivotX, by = collider.y1 - collider.pivotY;
+        Pose pose = { centerX + c * ax - s * ay, centerY + s * ax + c * ay, centerX + c * bx - s * by, centerY + s * bx + c * by };
+        return pose;
+    }
+
+    // Parameter of the point of the segment closest to (x, y), 0 at (x0, y0)
+    static float closestParameter(const Pose& pose, float x, float y) {
+        float dx = pose.x1 - pose.x0, dy = pose.y1 - pose.y0;
+        float lengthSquared = dx * dx + dy * dy;
+        if (lengthSquared <= 0.0f) return 0.0f;
+        return std::min(std::max(((x - pose.x0) * dx + (y - pose.y0) * dy) / lengthSquared, 0.0f), 1.0f);
+    }
+
+    static ColliderBounds poseBounds(const Pose& pose, float margin) {
+        ColliderBounds bounds = ColliderBounds::around(pose.x0, pose.y0, margin);
+        bounds.add(ColliderBounds::around(pose.x1, pose.y1, margin));
+        return bounds;
+    }
+
+    // Median split along the longer axis of the node's bounds
+    int buildNode(int first, int count) {
+        int index = static_cast<int>(nodes.size());
+        nodes.push_back(BvhNode());
+        ColliderBounds bounds = sweptBounds[order[first]];
+        for (int i = first + 1; i < first + count; i++) bounds.add(sweptBounds[order[i]]);
+        nodes[index].bounds = bounds;
+
+        if (count <= LEAF_SIZE) {
+            nodes[index].first = first;
+            nodes[index].count = count;
+            return index;
+        }
+        bool splitX = bounds.maxX - bounds.minX >= bounds.maxY - bounds.minY;
+        int half = count / 2;
+        std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count, [&](int a, int b) {
+            const ColliderBounds& p = sweptBounds[a];
+            const ColliderBounds& q = sweptBounds[b];
+            return splitX ? p.minX + p.maxX < q.minX + q.maxX : p.minY + p.maxY < q.minY + q.maxY;
+        });
+        int left = buildNode(first, half);
+        int right = buildNode(first + half, count - half);
+        nodes[index].first = 0;
+        nodes[index].count = 0;
+        nodes[index].left = left;
+        nodes[index].right = right;
+        return index;
+    }
+
+    // visit(collider) for every collider whose swept bounds overlap box, in a fixed order
+    template <typename Visit>
+    void query(const ColliderBounds& box, const Visit& visit) const {
+        int stack[64];
+        int depth = 0;
+        stack[depth++] = 0;
+        while (depth > 0) {
+            const BvhNode& node = nodes[stack[--depth]];
+            if (!node.bounds.overlaps(box)) continue;
+            if (node.count > 0) {
+                for (int i = node.first; i < node.first + node.count; i++) {
+                    if (sweptBounds[order[i]].overlaps(box)) visit(order[i]);
+                }
+            } else {
+                stack[depth++] = node.right;
+                stack[depth++] = node.left;
+            }
+        }
+    }
+
+    // Like the static colliders: out of the capsule along its normal, with the
+    // normal part of the velocity relative to the capsule's surface reflected
+    template <typename Position>
+    void collideParticle(int collider, Position* position, Position* last, float particleRadius, float damping) const {
+        const Pose& now = poses[collider];
+        float x = toWorld(position[0]);
+        float y = toWorld(position[1]);
+        float t = closestParameter(now, x, y);
+        float cx = now.x0 + (now.x1 - now.x0) * t;
+        float cy = now.y0 + (now.y1 - now.y0) * t;
+        float dx = x - cx, dy = y - cy;
+        float reach = colliders[collider].thickness * 0.5f + particleRadius;
+        float distanceSquared = dx * dx + dy * dy;
+        if (distanceSquared >= reach * reach) return;
+
+        float distance = std::sqrt(distanceSquared);
+        float normalX, normalY;
+        if (distance > 0.0f) {
+            normalX = dx / distance;
+            normalY = dy / distance;
+        } else {
+            // Center on the segment: out through the side of the capsule
+            float length = std::sqrt((now.x1 - now.x0) * (now.x1 - now.x0) + (now.y1 - now.y0) * (now.y1 - now.y0));
+            normalX = length > 0.0f ? -(now.y1 - now.y0) / length : 0.0f;
+            normalY = length > 0.0f ? (now.x1 - now.x0) / length : 1.0f;
+        }
+
+        // The surface point's travel over the substep, at the same place along the capsule
+        const Pose& before = lastPoses[collider];
+        float surfaceX = cx - (before.x0 + (before.x1 - before.x0) * t);
+        float surfaceY = cy - (before.y0 + (before.y1 - before.y0) * t);
+
+        float velocityX = toWorld(static_cast<Position>(position[0] - last[0]));
+        float velocityY = toWorld(static_cast<Position>(position[1] - last[1]));
+        float normalVelocity = (velocityX - surfaceX) * normalX + (velocityY - surfaceY) * normalY;
+        if (normalVelocity < 0.0f) {
+            velocityX -= (1.0f + damping) * normalVelocity * normalX;
+            velocityY -= (1.0f + damping) * normalVelocity * normalY;
+        }
+
+        float push = reach - distance;
+        position[0] += fromWorld<Position>(normalX * push);
+        position[1] += fromWorld<Position>(normalY * push);
+        last[0] = position[0] - fromWorld<Position>(velocityX);
+        last[1] = position[1] - fromWorld<Position>(velocityY);
+    }
+
+public:
+    bool empty() const { return colliders.empty(); }
+    int size() const { return static_cast<int>(colliders.size()); }
+    const std::vector<KinematicCollider>& getColliders() const { return colliders; }
+
+    void setColliders(const std::vector<KinematicCollider>& definitions) {
+        colliders = definitions;
+        nodes.clear();
+    }
+
+    // Poses at time and stepTime earlier, and the BVH over the sweep between
+    // them. The bounds reach particleRadius beyond the capsules plus the same
+    // again for particles the solver moved after the grid was built.
+    void update(double time, float stepTime, float particleRadius) {
+        size_t count = colliders.size();
+        poses.resize(count);
+        lastPoses.resize(count);
+        sweptBounds.resize(count);
+        order.resize(count);
+        for (size_t i = 0; i < count; i++) {
+            poses[i] = poseAt(colliders[i], time);
+            lastPoses[i] = poseAt(colliders[i], time - stepTime);
+            float margin = colliders[i].thickness * 0.5f + particleRadius * 2.0f;
+            sweptBounds[i] = poseBounds(poses[i], margin);
+            sweptBounds[i].add(poseBounds(lastPoses[i], margin));
+            order[i] = static_cast<int>(i);
+        }
+        nodes.clear();
+        if (count > 0) buildNode(0, static_cast<int>(count));
+    }
+
+    // After the substep's contact solve, on the grid it was built on. Rows of
+    // cells run in parallel from PARALLEL_PARTICLES_PER_THREAD particles per thread on, and
+    // every particle sits in exactly one cell, so the result does not depend
+    // on the thread count. Particles skipping the substep are pushed as well:
+    // a collider moves into them either way.
+    template <typename Position>
+    void collide(ThreadPool& pool, const SpatialGrid& grid, ArenaVector<Position>& positions, ArenaVector<Position>& lastPositions,
+                 int particleCount, float particleRadius, float damping) {
+        if (nodes.empty()) return;
+        const ColliderBounds& all = nodes[0].bounds;
+        int firstColumn = grid.getCellX(all.minX), lastColumn = grid.getCellX(all.maxX);
+        int firstRow = grid.getCellY(all.minY), lastRow = grid.getCellY(all.maxY);
+        float cellSize = grid.getCellSize();
+
+        int rows = lastRow - firstRow + 1;
+        rowTests.assign(rows, 0);
+        auto collideRow = [&](int task, int) {
+            int row = firstRow + task;
+            int tests = 0;
+            for (int column = firstColumn; column <= lastColumn; column++) {
+                const ArenaVector<int>& cell = grid.getCell(row * grid.getWidth() + column);
+                if (cell.empty()) continue;
+                ColliderBounds box = { grid.getMinX() + column * cellSize, grid.getMinY() + row * cellSize,
+                                       grid.getMinX() + (column + 1) * cellSize, grid.getMinY() + (row + 1) * cellSize };
+                query(box, [&](int collider) {
+                    for (int i : cell) collideParticle(collider, &positions[i * 2], &lastPositions[i * 2], particleRadius, damping);
+                    tests += static_cast<int>(cell.size());
+                });
+            }
+            rowTests[task] = tests;
+        };
+        if (particleCount < PARALLEL_PARTICLES_PER_THREAD * pool.getThreadCount()) {
+            for (int task = 0; task < rows; task++) collideRow(task, 0);
+        } else {
+            pool.parallelFor(rows, collideRow);
+        }
+
+        for (int tests : rowTests) particleTests += tests;
+        bruteForceTests += static_cast<long long>(particleCount) * size();
+        passes++;
+    }
+
+    // Capsule outline at the latest pose, for drawing
+    void getCapsule(int collider, float& x0, float& y0, float& x1, float& y1, float& thickness) const {
+        const Pose& pose = poses[collider];
+        x0 = pose.x0;
+        y0 = pose.y0;
+        x1 = pose.x1;
+        y1 = pose.y1;
+        thickness = colliders[collider].thickness;
+    }
+
+    void printStats() {
+        if (passes == 0) return;
+        printf("Kinematic Colliders: %d, %.0f particle tests per substep (%.1f%% of every particle against every collider)\n",
+               size(), passes > 0 ? static_cast<double>(particleTests) / passes : 0.0,
+               bruteForceTests > 0 ? 100.0 * particleTests / bruteForceTests : 0.0);
+        particleTests = 0;
+        bruteForceTests = 0;
+        passes = 0;
+    }
+};
+
+// Pixel rectangle [x0, x1) x [y0, y1), rows bottom-up
+struct PixelRect {
+    int x0, y0, x1, y1;
+
+    bool empty() const { return x0 >= x1 || y0 >= y1; }
+
+    void add(const PixelRect& other) {
+        if (other.empty()) return;
+        if (empty()) {
+            *this = other;
+            return;
+        }
+        x0 = std::min(x0, other.x0);
+        y0 = std::min(y0, other.y0);
+        x1 = std::max(x1, other.x1);
+        y1 = std::max(y1, other.y1);
+    }
+};
+
+// The static collider image with the kinematic colliders drawn over it, the
+// background every renderer draws the particles on. Each frame only the
+// pixels a capsule covered last frame or covers now are restored and drawn
+// again; those rectangles are all the GL path uploads.
+class KinematicLayer {
+private:
+    std::vector<uint32_t> pixels;
+    std::vector<PixelRect> drawn;   // Per collider, as of the last update
+    std::vector<PixelRect> changed;
+    int width = 0, height = 0;
+
+    PixelRect capsuleRect(float x0, float y0, float x1, float y1, float halfThickness) const {
+        float margin = halfThickness + 2.0f / std::min(width, height);
+        PixelRect rect = { static_cast<int>((std::min(x0, x1) - margin + 1.0f) * 0.5f * width),
+                           static_cast<int>((std::min(y0, y1) - margin + 1.0f) * 0.5f * height),
+                           static_cast<int>((std::max(x0, x1) + margin + 1.0f) * 0.5f * width) + 1,
+                           static_cast<int>((std::max(y0, y1) + margin + 1.0f) * 0.5f * height) + 1 };
+        rect.x0 = std::max(rect.x0, 0);
+        rect.y0 = std::max(rect.y0, 0);
+        rect.x1 = std::min(rect.x1, width);
+        rect.y1 = std::min(rect.y1, height);
+        return rect;
+    }
+
+public:
+    // The static image of the same size; drawing starts over on it
+    void reset(const std::vector<uint32_t>& background, int width, int height) {
+        this->width = width;
+        this->height = height;
+        pixels = background;
+        drawn.clear();
+    }
+
+    // Rectangles whose pixels changed, to upload again
+    const std::vector<PixelRect>& update(const KinematicColliders& kinematic, const std::vector<uint32_t>& background,
+                                         uint32_t fill, uint32_t edge) {
+        int count = kinematic.size();
+        drawn.resize(count, PixelRect{ 0, 0, 0, 0 });
+        changed.assign(drawn.begin(), drawn.end());
+
+        // All of last frame's capsules are erased before any is drawn, so overlapping ones stay whole
+        for (const PixelRect& rect : drawn) {
+            for (int row = rect.y0; row < rect.y1; row++) {
+                size_t offset = static_cast<size_t>(row) * width;
+                std::copy(background.begin() + offset + rect.x0, background.begin() + offset + rect.x1, pixels.begin() + offset + rect.x0);
+            }
+        }
+
+        float edgeWidth = 2.0f / std::min(width, height) * 1.5f;
+        for (int collider = 0; collider < count; collider++) {
+            float x0, y0, x1, y1, thickness;
+            kinematic.getCapsule(collider, x0, y0, x1, y1, thickness);
+            float half = thickness * 0.5f;
+            PixelRect rect = capsuleRect(x0, y0, x1, y1, half);
+            float dx = x1 - x0, dy = y1 - y0;
+            float lengthSquared = dx * dx + dy * dy;
+            for (int row = rect.y0; row < rect.y1; row++) {
+                float y = (row + 0.5f) * 2.0f / height - 1.0f;
+                for (int column = rect.x0; column < rect.x1; column++) {
+                    float x = (column + 0.5f) * 2.0f / width - 1.0f;
+                    float t = lengthSquared > 0.0f ? std::min(std::max(((x - x0) * dx + (y - y0) * dy) / lengthSquared, 0.0f), 1.0f) : 0.0f;
+                    float px = x - (x0 + dx * t), py = y - (y0 + dy * t);
+                    float distance = std::sqrt(px * px + py * py) - half;
+                    if (distance <= 0.0f) pixels[static_cast<size_t>(row) * width + column] = distance > -edgeWidth ? edge : fill;
+                }
+            }
+            drawn[collider] = rect;
+            changed[collider].add(rect);
+        }
+        return changed;
+    }
+
+    const std::vector<uint32_t>& image() const { return pixels; }
+    const uint32_t* data() const { return pixels.data(); }
+};
@@ -0,0 +1,138 @@
+#pragma once
+#include "SpatialGrid.h"
+#include "FixedPoint.h"
+#include <vector>
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+
+// Multi-rate local time stepping, opt-in with --integrator multirate.
+// Every grid cell gets a power-of-two substep level from the motion of the
+// particles inside it. A particle on level L is only integrated and collided
+// once every 2^L substeps, so resting regions cost a fraction of the updates
+// spent on the spawn jet and the impact zone.
+// Skipped substeps are treated as rest rather than folded into one 2^L times
+// larger step, so this changes the dynamics: a coarse particle's velocity
+// and gravity act 2^L times slower, and it holds still while its finer
+// neighbours take the whole contact correction. Folding needs more solver
+// passes than the savings allow, since loaded piles collapse when they get
+// fewer passes per simulated time (PERFORMANCE_GUIDE.md has the numbers). A
+// level is only granted when the motion over the skipped substeps stays
+// below maxStepDisplacement, which bounds the slowed-down travel.
+// Levels are only reassigned at frame boundaries, where all levels are in sync,
+// and a level's period never exceeds the frame's substep count.
+class LocalTimeStepping {
+private:
+    int maxLevel;
+    float maxStepDisplacement;      // Allowed travel of a particle over one of its level periods
+    ArenaVector<int> levels;        // Per particle
+    ArenaVector<int> cellLevels;    // Per grid cell, finest level of its particles
+    ArenaVector<int> regionLevels;  // Per grid cell, finest level of its 3x3 neighbourhood
+
+    long long particleUpdates = 0;
+    long long uniformUpdates = 0;
+
+public:
+    LocalTimeStepping(int maxLevel, float maxStepDisplacement)
+        : maxLevel(maxLevel), maxStepDisplacement(maxStepDisplacement) {}
+
+    // Must be called when all levels are synchronized (at the start of a frame).
+    // acceleration.at(x, y, ax, ay) gives the acceleration at a position.
+    template <typename Position, typename Acceleration>
+    void assignLevels(const SpatialGrid& grid, const ArenaVector<Position>& positions, const ArenaVector<Position>& lastPositions,
+                      const Acceleration& acceleration, int count, float deltaTime, int substeps) {
+        int levelLimit = maxLevel;
+        while (levelLimit > 0 && (1 << levelLimit) > substeps) levelLimit--;
+
+        levels.resize(count, 0); // Newly spawned particles start on the finest level
+        cellLevels.assign(grid.getWidth() * grid.getHeight(), levelLimit);
+
+        for (int i = 0; i < count; i++) {
+            // Displacement per substep
+            float vx = toWorld(positions[i * 2] - lastPositions[i * 2]);
+            float vy = toWorld(positions[i * 2 + 1] - lastPositions[i * 2 + 1]);
+            float speed = sqrtf(vx * vx + vy * vy);
+            float ax, ay;
+            acceleration.at(toWorld(positions[i * 2]), toWorld(positions[i * 2 + 1]), ax, ay);
+            float accel = sqrtf(ax * ax + ay * ay) * deltaTime * deltaTime;
+
+            // Coarsest level whose period still moves the particle less than maxStepDisplacement
+            int level = 0;
+            while (level < levelLimit) {
+                float steps = static_cast<float>(2 << level);
+                if (speed * steps + accel * steps * steps > maxStepDisplacement) break;
+                level++;
+            }
+
+            int cell = grid.getCellIndex(toWorld(positions[i * 2]), toWorld(positions[i * 2 + 1]));
+            cellLevels[cell] = std::min(cellLevels[cell], level);
+        }
+
+        // A region steps as finely as its fastest neighbour, so particles moving
+        // into a slow cell never skip over the boundary between levels
+        int width = grid.getWidth();
+        int height = grid.getHeight();
+        regionLevels.resize(cellLevels.size());
+        for (int gy = 0; gy < height; gy++) {
+            for (int gx = 0; gx < width; gx++) {
+                int level = levelLimit;
+                for (int ny = std::max(0, gy - 1); ny <= std::min(height - 1, gy + 1); ny++) {
+                    for (int nx = std::max(0, gx - 1); nx <= std::min(width - 1, gx + 1); nx++) {
+                        level = std::min(level, cellLevels[ny * width + nx]);
+                    }
+                }
+                regionLevels[gy * width + gx] = level;
+            }
+        }
+
+        for (int i = 0; i < count; i++) {
+            levels[i] = regionLevels[grid.getCellIndex(toWorld(positions[i * 2]), toWorld(positions[i * 2 + 1]))];
+        }
+    }
+
+    // A particle steps on the last substep of each of its 2^level periods,
+    // so all levels are in sync again when the frame ends
+    bool isActive(int particle, int step) const {
+        return ((step + 1) & ((1 << levels[particle]) - 1)) == 0;
+    }
+
+    void recordSubstep(int steppedParticles, int totalParticles) {
+        particleUpdates += steppedParticles;
+        uniformUpdates += totalParticles;
+    }
+
+    void printStats() {
+        std::vector<int> histogram(maxLevel + 1, 0);
+        for (int level : levels) {
+            histogram[level]++;
+        }
+        std::cout << "Time Levels:";
+        for (int level = 0; level <= maxLevel; level++) {
+            std::cout << " L" << level << "=" << histogram[level];
+        }
+        std::cout << std::endl;
+        std::cout << "Particle Updates: "
+                  << (uniformUpdates > 0 ? static_cast<float>(particleUpdates) / uniformUpdates * 100.0f : 0.0f)
+                  << "% of uniform stepping" << std::endl;
+        particleUpdates = 0;
+        uniformUpdates = 0;
+    }
+};
+
+// Every particle steps on every substep. Same interface as LocalTimeStepping,
+// but isActive is a constant, so the integrator and the collision kernels
+// instantiated with it lose their per-particle level checks.
+class UniformTimeStepping {
+public:
+    template <typename Position, typename Acceleration>
+    void assignLevels(const SpatialGrid&, const ArenaVector<Position>&, const ArenaVector<Position>&,
+                      const Acceleration&, int, float, int) {}
+
+    bool isActive(int, int) const { return true; }
+
+    void recordSubstep(int, int) {}
+
+    void printStats() {
+        std::cout << "Time Levels: uniform" << std::endl;
+    }
+};
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <thread>
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+
+// NUMA nodes and the CPUs of each this process may run on (cgroups and
+// taskset restrict them), from sysfs. Machines without the node directory
+// (or non-Linux systems) are one node holding every hardware thread.
+class NumaTopology {
+private:
+    std::vector<std::vector<int>> nodeCpus;
+
+    // "0-3,8-11" -> 0 1 2 3 8 9 10 11
+    static std::vector<int> parseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream ranges(list);
+        std::string range;
+        while (std::getline(ranges, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = std::stoi(range.substr(0, dash));
+            int last = dash == std::string::npos ? first : std::stoi(range.substr(dash + 1));
+            for (int cpu = first; cpu <= last; cpu++) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+
+public:
+    NumaTopology() {
+        for (int node = 0; ; node++) {
+            std::ifstream file("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+            std::string list;
+            if (!file || !std::getline(file, list)) break;
+            std::vector<int> cpus = parseCpuList(list);
+#ifdef __linux__
+            cpu_set_t allowed;
+            if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+                cpus.erase(std::remove_if(cpus.begin(), cpus.end(),
+                                          [&](int cpu) { return cpu >= CPU_SETSIZE || !CPU_ISSET(cpu, &allowed); }),
+                           cpus.end());
+            }
+#endif
+            if (!cpus.empty()) nodeCpus.push_back(cpus);
+        }
+        if (nodeCpus.empty()) {
+            nodeCpus.push_back(std::vector<int>());
+            int count = std::max(1u, std::thread::hardware_concurrency());
+            for (int cpu = 0; cpu < count; cpu++) nodeCpus[0].push_back(cpu);
+        }
+    }
+
+    int getNodeCount() const { return static_cast<int>(nodeCpus.size()); }
+
+    // CPUs node by node, so consecutive threads share a node until it is full
+    std::vector<int> cpuOrder() const {
+        std::vector<int> order;
+        for (const std::vector<int>& cpus : nodeCpus) {
+            order.insert(order.end(), cpus.begin(), cpus.end());
+        }
+        return order;
+    }
+
+    int nodeOfCpu(int cpu) const {
+        for (size_t node = 0; node < nodeCpus.size(); node++) {
+            if (std::find(nodeCpus[node].begin(), nodeCpus[node].end(), cpu) != nodeCpus[node].end()) {
+                return static_cast<int>(node);
+            }
+        }
+        return 0;
+    }
+};
+
+inline bool pinCurrentThread(int cpu) {
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpu;
+    return false;
+#endif
+}
+
+// Fixed slice of [0, capacity) owned by one of `parts` threads, clipped to the
+// live count. Slicing the capacity instead of the live count keeps every
+// particle on the same thread, and its memory on the same node, while more
+// particles spawn.
+inline void stableRange(int part, int parts, int capacity, int count, int& begin, int& end) {
+    begin = std::min(count, static_cast<int>(static_cast<long long>(capacity) * part / parts));
+    end = std::min(count, static_cast<int>(static_cast<long long>(capacity) * (part + 1) / parts));
+}
+
+// Touches the pages of `elements` reserved elements of `stride` bytes from the
+// thread owning each particle slice, so the kernel places each page on that
+// thread's node. pageSize is the storage's real page size (2 MB with huge
+// pages): a whole page goes to the node of its first touch, so each page is
+// touched once, by the slice holding its first byte in the storage. Must run
+// before anything else writes the storage; pages already in use (arena blocks
+// reused from an earlier simulation) keep their node. Returns false when a
+// slice has no page of its own and lives entirely on other threads' nodes:
+// with huge pages, that is every slice but the first of arrays smaller than a page.
+template <typename Pool>
+bool firstTouch(Pool& pool, void* storage, size_t stride, int elements, size_t pageSize) {
+    char* bytes = static_cast<char*>(storage);
+    uintptr_t start = reinterpret_cast<uintptr_t>(storage);
+    int parts = pool.getThreadCount();
+    std::vector<char> ownsPage(parts, 0);
+    pool.forEachThread([&](int thread) {
+        int begin, end;
+        stableRange(thread, parts, elements, elements, begin, end);
+        uintptr_t first = start + begin * stride, last = start + end * stride;
+        if (first >= last) return;
+        uintptr_t page = (first + pageSize - 1) / pageSize * pageSize; // First page starting inside the slice
+        if (begin == 0 && page != first) {
+            bytes[0] = 0; // The page the storage starts in
+            ownsPage[thread] = 1;
+        }
+        for (; page < last; page += pageSize) {
+            bytes[page - start] = 0;
+            ownsPage[thread] = 1;
+        }
+    });
+    for (int part = 0; part < parts; part++) {
+        int begin, end;
+        stableRange(part, parts, elements, elements, begin, end);
+        if (begin < end && !ownsPage[part]) return false;
+    }
+    return true;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include "glad/glad.h"
+#include <cstring>
+#include <iostream>
+#ifdef PARTICLE_SIM_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+// GL 3.3 core context without a window, rendering into a framebuffer object.
+// Mesa's surfaceless EGL platform needs neither a display server nor a GPU
+// (llvmpipe renders on the CPU); other EGL drivers get a 1x1 pbuffer when
+// they cannot make a context current without a surface.
+class OffscreenContext {
+private:
+    int width = 0;
+    int height = 0;
+    GLuint framebuffer = 0;
+    GLuint colorBuffer = 0;
+#ifdef PARTICLE_SIM_EGL
+    EGLDisplay display = EGL_NO_DISPLAY;
+    EGLContext context = EGL_NO_CONTEXT;
+    EGLSurface surface = EGL_NO_SURFACE;
+
+    static bool hasExtension(const char* extensions, const char* name) {
+        return extensions && std::strstr(extensions, name) != nullptr;
+    }
+
+    bool createContext() {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (getPlatformDisplay && hasExtension(eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS), "EGL_MESA_platform_surfaceless")) {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        if (display == EGL_NO_DISPLAY) display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+        EGLint major, minor;
+        if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API)) {
+            std::cout << "EGL initialization failed (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8,
+            EGL_NONE
+        };
+        EGLConfig config = nullptr;
+        EGLint configCount = 0;
+        eglChooseConfig(display, configAttributes, &config, 1, &configCount);
+        const char* extensions = eglQueryString(display, EGL_EXTENSIONS);
+        if (configCount == 0 && !hasExtension(extensions, "EGL_KHR_no_config_context")) {
+            std::cout << "No EGL config for offscreen GL rendering" << std::endl;
+            return false;
+        }
+
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        context = eglCreateContext(display, configCount > 0 ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+        if (context == EGL_NO_CONTEXT) {
+            std::cout << "EGL context creation failed (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+            return false;
+        }
+
+        if (!hasExtension(extensions, "EGL_KHR_surfaceless_context") && configCount > 0) {
+            const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            surface = eglCreatePbufferSurface(display, config, surfaceAttributes);
+        }
+        if (!eglMakeCurrent(display, surface, surface, context)) {
+            std::cout << "EGL make current failed (0x" << std::hex << eglGetError() << std::dec << ")" << std::endl;
+            return false;
+        }
+        return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+    }
+#endif
+
+public:
+    OffscreenContext() {}
+    OffscreenContext(const OffscreenContext&) = delete;
+    OffscreenContext& operator=(const OffscreenContext&) = delete;
+
+    ~OffscreenContext() {
+#ifdef PARTICLE_SIM_EGL
+        if (display == EGL_NO_DISPLAY) return;
+        if (context != EGL_NO_CONTEXT) {
+            if (framebuffer != 0) glDeleteFramebuffers(1, &framebuffer);
+            if (colorBuffer != 0) glDeleteRenderbuffers(1, &colorBuffer);
+            eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            eglDestroyContext(display, context);
+        }
+        if (surface != EGL_NO_SURFACE) eglDestroySurface(display, surface);
+        eglTerminate(display);
+#endif
+    }
+
+    // Makes the context current and binds a width x height RGBA8 framebuffer
+    bool create(int width, int height) {
+#ifdef PARTICLE_SIM_EGL
+        if (!createContext()) return false;
+        this->width = width;
+        this->height = height;
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            std::cout << "Offscreen framebuffer incomplete" << std::endl;
+            return false;
+        }
+        glViewport(0, 0, width, height);
+        return true;
+#else
+        (void)width;
+        (void)height;
+        std::cout << "Offscreen rendering needs EGL, this build has none" << std::endl;
+        return false;
+#endif
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+};
@@ -0,0 +1,202 @@
+#include "ParticleSimApi.h"
+#include "Simulation.h"
+#include "SignedDistanceField.h"
+#include "ColliderScene.h"
+#include "ForceField.h"
+#include <exception>
+#include <memory>
+#include <string>
+
+// The C API over SimulationBase. Everything a pipeline points to (colliders,
+// force field) lives in the handle, which never moves. psim_command only
+// touches the command queue, which psim_step drains.
+struct psim_simulation {
+    std::unique_ptr<SimulationBase> simulation;
+    SignedDistanceField colliders;
+    ForceField field;
+    std::string pipeline;
+    bool autoSpawn = true;
+    int spawnLayoutHeight = 720;
+    psim_step_callback callback = nullptr;
+    void* user = nullptr;
+    CommandQueue commands{COMMAND_QUEUE_SIZE};
+};
+
+namespace {
+
+thread_local std::string lastError;
+
+int32_t fail(const std::string& message) {
+    lastError = message;
+    return PSIM_ERROR;
+}
+
+}
+
+int32_t psim_api_version(void) { return PSIM_API_VERSION; }
+
+const char* psim_last_error(void) { return lastError.c_str(); }
+
+void psim_config_defaults(psim_config* config) {
+    if (!config) return;
+    config->seed = 0;
+    config->threads = WORKER_THREADS;
+    config->pin_threads = PIN_THREADS;
+    config->layout = DEFAULT_LAYOUT;
+    config->integrator = DEFAULT_INTEGRATOR;
+    config->scene = DEFAULT_SCENE;
+    config->field = DEFAULT_FORCE_FIELD;
+    config->collision_mode = static_cast<int32_t>(COLLISION_MODE);
+    config->auto_spawn = 1;
+    config->spawn_layout_height = 720;
+}
+
+psim_simulation* psim_create(const psim_config* config) {
+    psim_config defaults;
+    psim_config_defaults(&defaults);
+    if (!config) config = &defaults;
+    if (config->collision_mode < PSIM_COLLISIONS_SERIAL || config->collision_mode > PSIM_COLLISIONS_DETERMINISTIC) {
+        fail("Unknown collision mode " + std::to_string(config->collision_mode));
+        return nullptr;
+    }
+    try {
+        // Returns false when a host (or an earlier simulation) already reserved it
+        particleArena().reserve(ARENA_BYTES, ARENA_PAGE_MODE);
+
+        std::unique_ptr<psim_simulation> handle(new psim_simulation());
+        std::string layout = config->layout ? config->layout : DEFAULT_LAYOUT;
+        std::string integrator = config->integrator ? config->integrator : DEFAULT_INTEGRATOR;
+        handle->simulation = createSimulation(layout, integrator, config->threads, config->pin_threads != 0,
+                                              static_cast<CollisionMode>(config->collision_mode), config->seed);
+        if (!handle->simulation) {
+            fail("Unknown pipeline " + layout + "/" + integrator + ", available: " + availableSimulations());
+            return nullptr;
+        }
+        handle->pipeline = layout + "/" + integrator;
+
+        ColliderScene scene;
+        std::string sceneName = config->scene ? config->scene : DEFAULT_SCENE;
+        if (!loadColliderScene(sceneName, scene)) {
+            fail("Unknown scene or unreadable scene file: " + sceneName);
+            return nullptr;
+        }
+        handle->colliders.bake(scene, SDF_RESOLUTION);
+        handle->simulation->setColliders(&handle->colliders);
+        handle->simulation->setKinematicColliders(scene.kinematic);
+
+        std::string fieldName = config->field ? config->field : DEFAULT_FORCE_FIELD;
+        if (!handle->field.load(fieldName, FORCE_FIELD_RESOLUTION)) {
+            fail("Unknown force field or unreadable field file: " + fieldName);
+            return nullptr;
+        }
+        handle->simulation->setForceField(&handle->field);
+
+        handle->autoSpawn = config->auto_spawn != 0;
+        handle->spawnLayoutHeight = config->spawn_layout_height;
+        return handle.release();
+    } catch (const std::exception& error) {
+        fail(std::string("Creating the simulation failed: ") + error.what());
+        return nullptr;
+    }
+}
+
+void psim_destroy(psim_simulation* simulation) { delete simulation; }
+
+int32_t psim_step(psim_simulation* simulation, int32_t frames) {
+    if (!simulation) return fail("No simulation");
+    try {
+        SimulationBase& base = *simulation->simulation;
+        auto apply = [&](Command command) {
+            if (command.type == CommandType::Spawn && command.layoutHeight == 0) command.layoutHeight = simulation->spawnLayoutHeight;
+            base.applyCommand(command);
+        };
+        for (int32_t frame = 0; frame < frames; frame++) {
+            simulation->commands.drain(apply);
+            if (simulation->autoSpawn && base.spawnDue()) base.spawn(base.getSpawnCount(), simulation->spawnLayoutHeight);
+            if (simulation->callback) simulation->callback(simulation, PSIM_STEP_BEGIN, base.getFrame(), simulation->user);
+            base.step();
+            if (simulation->callback) simulation->callback(simulation, PSIM_STEP_END, base.getFrame() - 1, simulation->user);
+        }
+        return PSIM_OK;
+    } catch (const std::exception& error) {
+        return fail(std::string("Step failed: ") + error.what());
+    }
+}
+
+int32_t psim_spawn(psim_simulation* simulation, int32_t count) {
+    if (!simulation) return fail("No simulation");
+    if (count < 0) return fail("Negative spawn count");
+    try {
+        simulation->simulation->spawn(count, simulation->spawnLayoutHeight);
+        return PSIM_OK;
+    } catch (const std::exception& error) {
+        return fail(std::string("Spawn failed: ") + error.what());
+    }
+}
+
+int32_t psim_command(psim_simulation* simulation, const char* command) {
+    if (!simulation || !command) return fail("No simulation or command");
+    Command parsed;
+    std::string error;
+    if (!parseCommand(command, parsed, error)) return fail(error);
+    if (!simulation->commands.push(parsed)) return fail("Command queue full");
+    return PSIM_OK;
+}
+
+int32_t psim_set_substeps(psim_simulation* simulation, int32_t substeps) {
+    if (!simulation) return fail("No simulation");
+    if (substeps < 1 || substeps > UPDATER_PER_FRAME || (substeps & (substeps - 1)) != 0) {
+        return fail("Substeps must be a power of two up to " + std::to_string(static_cast<int>(UPDATER_PER_FRAME)));
+    }
+    simulation->simulation->setSubsteps(substeps);
+    return PSIM_OK;
+}
+
+int32_t psim_set_collision_mode(psim_simulation* simulation, int32_t mode) {
+    if (!simulation) return fail("No simulation");
+    if (mode < PSIM_COLLISIONS_SERIAL || mode > PSIM_COLLISIONS_DETERMINISTIC) return fail("Unknown collision mode " + std::to_string(mode));
+    simulation->simulation->setCollisionMode(static_cast<CollisionMode>(mode));
+    return PSIM_OK;
+}
+
+void psim_set_gravity(psim_simulation* simulation, float x, float y) {
+    if (simulation) simulation->simulation->setGravity(x, y);
+}
+
+void psim_set_step_callback(psim_simulation* simulation, psim_step_callback callback, void* user) {
+    if (!simulation) return;
+    simulation->callback = callback;
+    simulation->user = user;
+}
+
+int32_t psim_particle_count(const psim_simulation* simulation) { return simulation ? simulation->simulation->getParticleCount() : 0; }
+
+int64_t psim_frame(const psim_simulation* simulation) { return simulation ? simulation->simulation->getFrame() : 0; }
+
+uint64_t psim_checksum(const psim_simulation* simulation) { return simulation ? simulation->simulation->getChecksum() : 0; }
+
+float psim_step_time(const psim_simulation* simulation) { return simulation ? simulation->simulation->getStepTime() : 0.0f; }
+
+const char* psim_pipeline(const psim_simulation* simulation) { return simulation ? simulation->pipeline.c_str() : ""; }
+
+int32_t psim_get_buffers(psim_simulation* simulation, psim_buffers* buffers) {
+    if (!simulation || !buffers) return fail("No simulation or buffers");
+    PositionStorage storage = simulation->simulation->getPositionStorage();
+    buffers->positions = storage.positions;
+    buffers->last_positions = storage.lastPositions;
+    buffers->count = simulation->simulation->getParticleCount();
+    buffers->capacity = NUMCIRCLES;
+    buffers->scalar = storage.fixedPoint ? PSIM_FIXED32 : PSIM_FLOAT32;
+    buffers->scale = storage.fixedPoint ? 1.0 / FIXED_ONE : 1.0;
+    return PSIM_OK;
+}
+
+const float* psim_world_positions(psim_simulation* simulation) {
+    if (!simulation) return nullptr;
+    try {
+        return simulation->simulation->getWorldPositions();
+    } catch (const std::exception& error) {
+        fail(std::string("Converting the positions failed: ") + error.what());
+        return nullptr;
+    }
+}
@@ -0,0 +1,133 @@
+#ifndef PARTICLE_SIM_API_H
+#define PARTICLE_SIM_API_H
+
+/* C interface of the particle_sim shared library, for host applications
+ * and foreign function interfaces (Python ctypes and the like). Everything
+ * is plain C: opaque handles, fixed-size integers and structs that only
+ * grow at the end, so clients built against an older header keep working.
+ * PSIM_API_VERSION changes when that is no longer true.
+ *
+ * A simulation is not thread safe: call into one handle from one thread at
+ * a time, except for psim_command, which any thread may call at any time.
+ * Its worker threads only run inside psim_step. */
+
+#include <stdint.h>
+
+#if defined(_WIN32)
+#  if defined(PARTICLE_SIM_BUILD_LIBRARY)
+#    define PSIM_API __declspec(dllexport)
+#  else
+#    define PSIM_API __declspec(dllimport)
+#  endif
+#else
+#  define PSIM_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PSIM_API_VERSION 1
+
+/* Return codes */
+#define PSIM_OK 0
+#define PSIM_ERROR -1 /* psim_last_error() says why */
+
+typedef struct psim_simulation psim_simulation;
+
+typedef enum {
+    PSIM_COLLISIONS_SERIAL = 0,
+    PSIM_COLLISIONS_PARALLEL = 1,
+    PSIM_COLLISIONS_DETERMINISTIC = 2 /* bitwise identical on any thread count */
+} psim_collision_mode;
+
+typedef enum {
+    PSIM_FLOAT32 = 0, /* float world units */
+    PSIM_FIXED32 = 1  /* int32, scale world units per step */
+} psim_scalar;
+
+typedef enum {
+    PSIM_STEP_BEGIN = 0, /* before the frame's physics, after its spawn */
+    PSIM_STEP_END = 1    /* after the frame's physics */
+} psim_step_phase;
+
+/* Fill with psim_config_defaults, then change what differs */
+typedef struct {
+    uint32_t seed;
+    int32_t threads;            /* 0 = one per hardware thread */
+    int32_t pin_threads;
+    const char* layout;         /* "float" or "fixed" */
+    const char* integrator;     /* "multirate" or "uniform" */
+    const char* scene;          /* Built-in collider scene or scene file */
+    const char* field;          /* Built-in force field or field file, "none" */
+    int32_t collision_mode;     /* psim_collision_mode */
+    int32_t auto_spawn;         /* psim_step spawns on the app's schedule */
+    int32_t spawn_layout_height; /* Window height spawn columns are spaced for */
+} psim_config;
+
+/* The particle arrays themselves, x, y per particle. Reads and writes
+ * between steps go straight to the simulation; the pointers stay valid until
+ * psim_destroy, but count does not. Spawns append particles. A "remove"
+ * command compacts the arrays in place: the survivors keep their order but
+ * move down over the removed ones, so count shrinks and an index held
+ * across the step may name another particle. Refetch the buffers after
+ * every step or command. */
+typedef struct {
+    void* positions;
+    void* last_positions;  /* One step earlier; (position - last) / step time is the velocity */
+    int32_t count;         /* Particles */
+    int32_t capacity;      /* Particles the arrays hold */
+    int32_t scalar;        /* psim_scalar */
+    double scale;          /* World units per stored unit */
+} psim_buffers;
+
+typedef void (*psim_step_callback)(psim_simulation* simulation, int32_t phase, int64_t frame, void* user);
+
+PSIM_API int32_t psim_api_version(void);
+
+/* Message of the last failed call on this thread */
+PSIM_API const char* psim_last_error(void);
+
+PSIM_API void psim_config_defaults(psim_config* config);
+
+/* Null on failure */
+PSIM_API psim_simulation* psim_create(const psim_config* config);
+PSIM_API void psim_destroy(psim_simulation* simulation);
+
+/* frames rendered frames of physics, each with the configured substeps */
+PSIM_API int32_t psim_step(psim_simulation* simulation, int32_t frames);
+
+/* A column of up to count particles at the top left, moving right */
+PSIM_API int32_t psim_spawn(psim_simulation* simulation, int32_t count);
+
+/* Queues a command line ("gravity 0 -5", "damping 0.8", "spawn_interval 20",
+ * "spawn_count 5", "spawn 10", "remove 0 0 0.2", "mode deterministic",
+ * "substeps 4") for the start of the next frame psim_step runs. Lock-free and
+ * callable from any thread; PSIM_ERROR when it does not parse or the queue is full. */
+PSIM_API int32_t psim_command(psim_simulation* simulation, const char* command);
+
+PSIM_API int32_t psim_set_substeps(psim_simulation* simulation, int32_t substeps); /* Power of two */
+PSIM_API int32_t psim_set_collision_mode(psim_simulation* simulation, int32_t mode);
+PSIM_API void psim_set_gravity(psim_simulation* simulation, float x, float y);
+
+/* Called on the stepping thread around every frame; null removes it */
+PSIM_API void psim_set_step_callback(psim_simulation* simulation, psim_step_callback callback, void* user);
+
+PSIM_API int32_t psim_particle_count(const psim_simulation* simulation);
+PSIM_API int64_t psim_frame(const psim_simulation* simulation);
+PSIM_API uint64_t psim_checksum(const psim_simulation* simulation); /* State checksum of the latest frame */
+PSIM_API float psim_step_time(const psim_simulation* simulation);
+PSIM_API const char* psim_pipeline(const psim_simulation* simulation); /* "layout/integrator" */
+
+PSIM_API int32_t psim_get_buffers(psim_simulation* simulation, psim_buffers* buffers);
+
+/* Positions as float world units, x, y per particle, valid until the next
+ * step: the arrays themselves for the float layout, a converted copy for fixed;
+ * null with psim_last_error set when the copy cannot be allocated */
+PSIM_API const float* psim_world_positions(psim_simulation* simulation);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -1,11 +1,13 @@
 #pragma once
 #include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <string>
 #include <vector>
 #include <numeric>
 #include <algorithm>
 #include <sys/resource.h>
+#include "HardwareCounters.h"
 
 
 class PerformanceProfiler {
@@ -13,15 +15,54 @@ class PerformanceProfiler {
 private:
     struct TimingData {
         std::string name;
+        std::string backend;            // Pipeline the samples were taken on, empty before the first one
         std::vector<double> measurements;
         double totalTime = 0.0;
         size_t callCount = 0;
+        std::vector<double> tlbMisses;  // Per call, only filled when the counter is available
+        double totalTlbMisses = 0.0;
     };
     
     std::vector<TimingData> timers;
-    std::chrono::high_resolution_clock::time_point startTime;
+    std::string backend;
+
+    // dTLB load misses of the thread that created the profiler (the main thread,
+    // at static initialization) and of every thread started since, so the pool
+    // workers are counted too
+    HardwareCounter tlbCounter;
+    
+    // Timers are split by backend, so switching pipelines never mixes their samples
+    TimingData& findOrCreateTimer(const std::string& name) {
+        auto it = std::find_if(timers.begin(), timers.end(), 
+                              [&](const TimingData& t) { return t.name == name && t.backend == backend; });
+        if (it != timers.end()) return *it;
+        TimingData newTimer;
+        newTimer.name = name;
+        newTimer.backend = backend;
+        timers.push_back(newTimer);
+        return timers.back();
+    }
+
+    static double average(const TimingData& timer) {
+        return timer.callCount > 0 ? timer.totalTime / timer.callCount : 0.0;
+    }
+
+    static void addSample(TimingData& timer, double microseconds) {
+        timer.measurements.push_back(microseconds);
+        timer.totalTime += microseconds;
+
+        // Keep only last 100 measurements for rolling average
+        if (timer.measurements.size() > 100) {
+            timer.totalTime -= timer.measurements.front();
+            timer.measurements.erase(timer.measurements.begin());
+        }
+        timer.callCount = timer.measurements.size();
+    }
     
 public:
+    PerformanceProfiler() {
+        openTlbMissCounter(tlbCounter);
+    }
     
     int collisionCheck = 0;
     int collisionVerified = 0;
@@ -42,45 +83,38 @@ public:
         std::cout << "Memory: " << usage.ru_maxrss << " KB" << std::endl;
     }
 
-    void startTimer(const std::string& name) {
-        startTime = std::chrono::high_resolution_clock::now();
-    }
-    
-    void endTimer(const std::string& name) {
-        auto endTime = std::chrono::high_resolution_clock::now();
-        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
-        double microseconds = duration.count();
-        
-        // Find or create timer
-        auto it = std::find_if(timers.begin(), timers.end(), 
-                              [&name](const TimingData& t) { return t.name == name; });
-        
-        if (it == timers.end()) {
-            TimingData newTimer;
-            newTimer.name = name;
-            newTimer.measurements.push_back(microseconds);
-            newTimer.totalTime = microseconds;
-            newTimer.callCount = 1;
-            timers.push_back(newTimer);
-        } else {
-            it->measurements.push_back(microseconds);
-            it->totalTime += microseconds;
-            it->callCount++;
-            
-            // Keep only last 100 measurements for rolling average
-            if (it->measurements.size() > 100) {
-                it->totalTime -= it->measurements.front();
-                it->measurements.erase(it->measurements.begin());
-                it->callCount = it->measurements.size();
+    // Samples from here on belong to this backend (layout, integrator, threads, collision mode)
+    void setBackend(const std::string& name) { backend = name; }
+    const std::string& getBackend() const { return backend; }
+
+    uint64_t readTlbMisses() const { return tlbCounter.read(); }
+
+    // One finished scope; ScopedTimer keeps its own start, so scopes can nest
+    void recordScope(const std::string& name, double microseconds, double misses) {
+        TimingData& timer = findOrCreateTimer(name);
+        addSample(timer, microseconds);
+        if (tlbCounter.isAvailable()) {
+            timer.tlbMisses.push_back(misses);
+            timer.totalTlbMisses += misses;
+            if (timer.tlbMisses.size() > 100) {
+                timer.totalTlbMisses -= timer.tlbMisses.front();
+                timer.tlbMisses.erase(timer.tlbMisses.begin());
             }
         }
     }
+
+    // A duration measured elsewhere (GPU timer queries), reported like a CPU scope
+    void recordTime(const std::string& name, double microseconds) {
+        addSample(findOrCreateTimer(name), microseconds);
+    }
     
+    // Timers of the current backend, and those taken before any backend was set (startup)
     void printStats() {
         std::cout << "\n=== Performance Stats ===" << std::endl;
+        if (!backend.empty()) std::cout << "Backend: " << backend << "\n" << std::endl;
         for (const auto& timer : timers) {
-            if (timer.callCount > 0) {
-                double avgTime = timer.totalTime / timer.callCount;
+            if (timer.callCount > 0 && (timer.backend.empty() || timer.backend == backend)) {
+                double avgTime = average(timer);
                 double minTime = *std::min_element(timer.measurements.begin(), timer.measurements.end());
                 double maxTime = *std::max_element(timer.measurements.begin(), timer.measurements.end());
                 
@@ -90,15 +124,48 @@ public:
                 std::cout << "  Max: " << maxTime << "μs" << std::endl;
                 std::cout << "  Calls: " << timer.callCount << std::endl;
                 std::cout << "  Total: " << timer.totalTime/1000.0 << "ms" << std::endl;
+                if (!timer.tlbMisses.empty()) {
+                    std::cout << "  dTLB Misses: " << timer.totalTlbMisses / timer.tlbMisses.size() << "/call" << std::endl;
+                }
                 std::cout << std::endl;
             }
         }
     }
     
+    // Every scope measured on more than one backend, side by side, relative to
+    // the first backend it was measured on
+    void printBackendComparison() {
+        bool header = false;
+        for (size_t i = 0; i < timers.size(); i++) {
+            const TimingData& first = timers[i];
+            if (first.backend.empty() || first.callCount == 0) continue;
+            bool seenBefore = false, otherBackend = false;
+            for (size_t j = 0; j < timers.size(); j++) {
+                if (timers[j].name != first.name || timers[j].backend.empty() || timers[j].callCount == 0) continue;
+                if (j < i) seenBefore = true;
+                if (timers[j].backend != first.backend) otherBackend = true;
+            }
+            if (seenBefore || !otherBackend) continue;
+
+            if (!header) {
+                std::cout << "\n=== Backend Comparison (avg of the last 100 calls) ===" << std::endl;
+                header = true;
+            }
+            std::cout << first.name << ":" << std::endl;
+            double baseline = average(first);
+            for (const TimingData& timer : timers) {
+                if (timer.name != first.name || timer.backend.empty() || timer.callCount == 0) continue;
+                printf("  %-40s %10.1fμs", timer.backend.c_str(), average(timer));
+                if (&timer != &first && baseline > 0.0) printf(" (%+.1f%%)", (average(timer) / baseline - 1.0) * 100.0);
+                printf("%s\n", timer.backend == backend ? "  <- current" : "");
+            }
+        }
+    }
+
     double getAverageTime(const std::string& name) {
         auto it = std::find_if(timers.begin(), timers.end(), 
-                              [&name](const TimingData& t) { return t.name == name; });
-        return (it != timers.end() && it->callCount > 0) ? it->totalTime / it->callCount : 0.0;
+                              [&](const TimingData& t) { return t.name == name && t.backend == backend; });
+        return it != timers.end() ? average(*it) : 0.0;
     }
 };
 
@@ -107,14 +174,19 @@ class ScopedTimer {
 private:
     PerformanceProfiler& profiler;
     std::string name;
+    uint64_t startTlbMisses;
+    std::chrono::high_resolution_clock::time_point startTime;
     
 public:
     ScopedTimer(PerformanceProfiler& p, const std::string& n) : profiler(p), name(n) {
-        profiler.startTimer(name);
+        startTlbMisses = profiler.readTlbMisses();
+        startTime = std::chrono::high_resolution_clock::now();
     }
     
     ~ScopedTimer() {
-        profiler.endTimer(name);
+        auto duration = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::high_resolution_clock::now() - startTime);
+        profiler.recordScope(name, static_cast<double>(duration.count()),
+                             static_cast<double>(profiler.readTlbMisses() - startTlbMisses));
     }
 };
 
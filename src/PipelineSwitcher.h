@@ -0,0 +1,137 @@
+#pragma once
+#include "Simulation.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// A physics backend: the layout/integrator pipeline and its thread count
+struct PipelineSpec {
+    std::string layout = DEFAULT_LAYOUT;
+    std::string integrator = DEFAULT_INTEGRATOR;
+    int threads = WORKER_THREADS; // <= 0: every hardware thread
+};
+
+inline int resolveThreadCount(int threads) {
+    return threads > 0 ? threads : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+}
+
+// "layout/integrator[/threads]", e.g. "fixed/uniform/4"
+inline bool parsePipelineSpec(const std::string& text, PipelineSpec& spec) {
+    size_t first = text.find('/');
+    if (first == std::string::npos) return false;
+    size_t second = text.find('/', first + 1);
+    spec.layout = text.substr(0, first);
+    spec.integrator = text.substr(first + 1, second == std::string::npos ? std::string::npos : second - first - 1);
+    if (second != std::string::npos) {
+        char* end = nullptr;
+        spec.threads = static_cast<int>(std::strtol(text.c_str() + second + 1, &end, 10));
+        if (*end != '\0' || spec.threads < 0) return false;
+    }
+    return !spec.layout.empty() && !spec.integrator.empty();
+}
+
+inline bool samePipeline(const PipelineSpec& a, const PipelineSpec& b) {
+    return a.layout == b.layout && a.integrator == b.integrator && resolveThreadCount(a.threads) == resolveThreadCount(b.threads);
+}
+
+// Thread counts the T key steps through: doubling up to every hardware thread, then back to one
+inline int nextThreadCount(int threads) {
+    int hardware = resolveThreadCount(0);
+    return threads >= hardware ? 1 : std::min(threads * 2, hardware);
+}
+
+// Profiler backend name; the collision mode is not part of it since the
+// collision scopes are already named by mode
+inline std::string pipelineLabel(const SimulationBase& simulation) {
+    return std::string(simulation.getLayoutName()) + "/" + simulation.getIntegratorName() + " x" +
+           std::to_string(simulation.getThreadCount());
+}
+
+// Moves the running scene between pipelines between frames. Only the active
+// pipeline and the retained ones (the --ab list) are kept, so switching back
+// and forth for an A/B comparison allocates nothing after the first round and
+// finds its thread pool already running. Any other pipeline is destroyed when
+// the scene leaves it, joining its workers and returning its arrays to the
+// arena's free lists, so stepping through thread counts with T holds at most
+// the retained pools plus the active one.
+class PipelineSwitcher {
+private:
+    std::vector<std::unique_ptr<SimulationBase>> pipelines;
+    std::vector<PipelineSpec> retained;
+    SimulationBase* active = nullptr;
+    bool pinThreads;
+    uint32_t seed;
+    SimulationState state;
+
+    static bool matches(const SimulationBase& pipeline, const PipelineSpec& spec) {
+        return spec.layout == pipeline.getLayoutName() && spec.integrator == pipeline.getIntegratorName() &&
+               resolveThreadCount(spec.threads) == pipeline.getThreadCount();
+    }
+
+    bool isRetained(const SimulationBase& pipeline) const {
+        for (const PipelineSpec& spec : retained) {
+            if (matches(pipeline, spec)) return true;
+        }
+        return false;
+    }
+
+    SimulationBase* find(const PipelineSpec& spec) {
+        for (const std::unique_ptr<SimulationBase>& pipeline : pipelines) {
+            if (matches(*pipeline, spec)) return pipeline.get();
+        }
+        std::unique_ptr<SimulationBase> created = createSimulation(spec.layout, spec.integrator, spec.threads, pinThreads,
+                                                                   active ? active->getCollisionMode() : COLLISION_MODE, seed);
+        if (!created) return nullptr;
+        pipelines.push_back(std::move(created));
+        return pipelines.back().get();
+    }
+
+public:
+    PipelineSwitcher(bool pinThreads, uint32_t seed) : pinThreads(pinThreads), seed(seed) {}
+
+    // Pipelines kept alive while the scene runs elsewhere
+    void retain(const std::vector<PipelineSpec>& specs) { retained = specs; }
+
+    // First pipeline of the run, null for an unknown layout/integrator
+    SimulationBase* start(const PipelineSpec& spec, CollisionMode mode) {
+        active = find(spec);
+        if (active) active->setCollisionMode(mode);
+        return active;
+    }
+
+    // False for an unknown layout/integrator, the scene stays where it is
+    bool switchTo(const PipelineSpec& spec) {
+        SimulationBase* target = find(spec);
+        if (!target) {
+            std::cout << "Unknown pipeline " << spec.layout << "/" << spec.integrator
+                      << ", available: " << availableSimulations() << std::endl;
+            return false;
+        }
+        if (target == active) return true;
+
+        active->saveState(state);
+        target->restoreState(state);
+        active = target;
+        pipelines.erase(std::remove_if(pipelines.begin(), pipelines.end(),
+                                       [&](const std::unique_ptr<SimulationBase>& pipeline) {
+                                           return pipeline.get() != active && !isRetained(*pipeline);
+                                       }),
+                        pipelines.end());
+        std::cout << "Pipeline: " << pipelineLabel(*active) << " from frame " << active->getFrame() << std::endl;
+        return true;
+    }
+
+    SimulationBase& current() { return *active; }
+
+    PipelineSpec currentSpec() const {
+        PipelineSpec spec;
+        spec.layout = active->getLayoutName();
+        spec.integrator = active->getIntegratorName();
+        spec.threads = active->getThreadCount();
+        return spec;
+    }
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "PerformanceProfiler.h"
+#include <algorithm>
+#include <cstdio>
+
+// One step of the quality ladder
+struct QualityLevel {
+    int substeps;             // Physics substeps per frame, a power of two
+    int lod;                  // Index into CIRCLE_LOD_SEGMENTS
+    int statsIntervalSeconds; // Seconds between detailed stats reports
+};
+
+// Cheapest changes first: circle tessellation, which only saves GPU draw
+// time, then coarser physics. Stats reports get rarer along with those
+// steps rather than on a step of their own, since their cost is too small
+// to show in the averages. Four substeps is the floor, below it fast
+// particles tunnel through each other at the spawn velocity.
+const QualityLevel QUALITY_LEVELS[] = {
+    { 8, 0, STATS_INTERVAL_SECONDS },
+    { 8, 1, STATS_INTERVAL_SECONDS },
+    { 8, 2, STATS_INTERVAL_SECONDS * 2 },
+    { 4, 2, STATS_INTERVAL_SECONDS * 4 },
+};
+const int QUALITY_LEVEL_COUNT = sizeof(QUALITY_LEVELS) / sizeof(QUALITY_LEVELS[0]);
+
+// Holds the frame inside FRAME_BUDGET_MS. Off unless run with --governor, since
+// its substep steps change the physics. The frame cost is rebuilt from the
+// profiler's rolling per-phase averages: CPU physics, per-frame analysis and
+// render submission,
+// and the GPU scopes of GpuTimer.h, the frame taking as long as the slower
+// of the two. A frame over budget moves down to the next level predicted to
+// make it cheaper, so a GPU-only step is skipped while the CPU is the limit
+// (or without GPU timer queries), and a level is restored once its predicted
+// cost fits in GOVERNOR_RESTORE_FRACTION of the budget. After every change
+// the governor waits GOVERNOR_SETTLE_FRAMES so the averages reflect it.
+class QualityGovernor {
+private:
+    double budgetMs;
+    int level = 0;
+    int framesSinceChange = 0;
+
+    struct FrameCost {
+        double physicsMs; // Scales with the substep count
+        double perFrameMs; // Per-frame CPU work: level assignment and amortized analytics passes
+        double renderMs;  // CPU submit time, independent of the tessellation
+        double drawMs;    // GPU circle drawing, scales with the segments per circle
+        double otherGpuMs;
+
+        double cpuMs() const { return physicsMs + perFrameMs + renderMs; }
+        double gpuMs() const { return drawMs + otherGpuMs; }
+        double totalMs() const { return std::max(cpuMs(), gpuMs()); }
+    };
+
+    double predictFrameMs(const FrameCost& cost, int target) const {
+        FrameCost predicted = cost;
+        predicted.physicsMs *= static_cast<double>(QUALITY_LEVELS[target].substeps) / QUALITY_LEVELS[level].substeps;
+        predicted.drawMs *= static_cast<double>(CIRCLE_LOD_SEGMENTS[QUALITY_LEVELS[target].lod]) /
+                            CIRCLE_LOD_SEGMENTS[QUALITY_LEVELS[level].lod];
+        return predicted.totalMs();
+    }
+
+    void change(int target, double frameMs) {
+        const QualityLevel& next = QUALITY_LEVELS[target];
+        printf("Quality: level %d -> %d (frame %.2f ms, budget %.2f ms): %d substeps, %d-segment circles, "
+               "stats every %d s\n",
+               level, target, frameMs, budgetMs, next.substeps, CIRCLE_LOD_SEGMENTS[next.lod], next.statsIntervalSeconds);
+        level = target;
+        framesSinceChange = 0;
+    }
+
+public:
+    explicit QualityGovernor(double budgetMs) : budgetMs(budgetMs) {}
+
+    const QualityLevel& current() const { return QUALITY_LEVELS[level]; }
+
+    // After a pipeline switch the new backend's averages are empty or stale
+    void settle() { framesSinceChange = 0; }
+    int getLevel() const { return level; }
+
+    // Called once per frame after its work; returns true when the level changed.
+    // kinematic says whether the scene has moving colliders, whose pass runs
+    // every substep; analyticsInterval is the frames between analytics passes,
+    // 0 when they are off. Both leave stale averages behind when turned off.
+    bool update(PerformanceProfiler& profiler, const char* collisionScope, bool kinematic, int analyticsInterval) {
+        if (++framesSinceChange < GOVERNOR_SETTLE_FRAMES) return false;
+
+        int substeps = QUALITY_LEVELS[level].substeps;
+        double substepUs = profiler.getAverageTime("Verlet Integration") + profiler.getAverageTime("Wall Collisions") +
+                           profiler.getAverageTime(collisionScope);
+        if (kinematic) substepUs += profiler.getAverageTime("Kinematic Colliders");
+        double frameUs = profiler.getAverageTime("Time Level Assignment");
+        if (analyticsInterval > 0) frameUs += profiler.getAverageTime("Analytics") / analyticsInterval;
+        FrameCost cost;
+        cost.physicsMs = substepUs * substeps / 1000.0;
+        cost.perFrameMs = frameUs / 1000.0;
+        cost.renderMs = profiler.getAverageTime("Rendering") / 1000.0;
+        cost.drawMs = profiler.getAverageTime("GPU Draw") / 1000.0;
+        cost.otherGpuMs = (profiler.getAverageTime("GPU Upload") + profiler.getAverageTime("GPU Blit") +
+                           profiler.getAverageTime("GPU HUD")) / 1000.0;
+        double frameMs = cost.totalMs();
+
+        if (frameMs > budgetMs) {
+            for (int target = level + 1; target < QUALITY_LEVEL_COUNT; target++) {
+                if (predictFrameMs(cost, target) < frameMs) {
+                    change(target, frameMs);
+                    return true;
+                }
+            }
+            return false;
+        }
+        if (level > 0 && predictFrameMs(cost, level - 1) < budgetMs * GOVERNOR_RESTORE_FRACTION) {
+            change(level - 1, frameMs);
+            return true;
+        }
+        return false;
+    }
+};
@@ -0,0 +1,106 @@
+#pragma once
+#include "glad/glad.h"
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Linked shader program saved to disk with glGetProgramBinary and restored
+// with glProgramBinary, so warm starts skip compiling and linking (which is
+// slow under llvmpipe). A binary only loads on the driver that produced it,
+// so the file is keyed by a hash of GL_VENDOR, GL_RENDERER, GL_VERSION and
+// the shader sources. A different key, or a binary the driver rejects, falls
+// back to compiling, and the new program replaces the file.
+class ShaderCache {
+private:
+    static const uint32_t MAGIC = 0x43485350; // "PSHC"
+
+    std::string path;
+    uint64_t key = 14695981039346656037ULL;
+    bool supported = false;
+    bool hit = false;
+    bool stored = false;
+
+    // FNV-1a, including the terminator so "ab" + "c" differs from "a" + "bc"
+    void hash(const char* text) {
+        if (!text) text = "";
+        do {
+            key ^= static_cast<unsigned char>(*text);
+            key *= 1099511628211ULL;
+        } while (*text++);
+    }
+
+public:
+    // Needs a current context; an empty path disables the cache
+    ShaderCache(const std::string& path, const char* vertexSource, const char* fragmentSource) : path(path) {
+        GLint formats = 0;
+        if (glGetProgramBinary && glProgramBinary) glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        supported = !path.empty() && formats > 0;
+
+        hash(reinterpret_cast<const char*>(glGetString(GL_VENDOR)));
+        hash(reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+        hash(reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+        hash(vertexSource);
+        hash(fragmentSource);
+    }
+
+    // Linked program from the cache, 0 on a miss
+    GLuint load() {
+        if (!supported) return 0;
+        FILE* file = fopen(path.c_str(), "rb");
+        if (!file) return 0;
+
+        uint32_t magic = 0, format = 0, size = 0;
+        uint64_t fileKey = 0;
+        bool valid = fread(&magic, sizeof(magic), 1, file) == 1 && fread(&fileKey, sizeof(fileKey), 1, file) == 1 &&
+                     fread(&format, sizeof(format), 1, file) == 1 && fread(&size, sizeof(size), 1, file) == 1 &&
+                     magic == MAGIC && fileKey == key && size > 0;
+        std::vector<char> binary(valid ? size : 0);
+        valid = valid && fread(binary.data(), 1, size, file) == size;
+        fclose(file);
+        if (!valid) return 0;
+
+        GLuint program = glCreateProgram();
+        glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(size));
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            // Driver update or rejected binary
+            glDeleteProgram(program);
+            return 0;
+        }
+        hit = true;
+        return program;
+    }
+
+    // Saves a freshly linked program, written to a temporary file and renamed
+    // so a crash never leaves a torn cache behind
+    bool store(GLuint program) {
+        if (!supported) return false;
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) return false;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(program, length, &length, &format, binary.data());
+
+        std::string temporary = path + ".tmp";
+        FILE* file = fopen(temporary.c_str(), "wb");
+        if (!file) return false;
+        uint32_t magic = MAGIC, binaryFormat = format, size = static_cast<uint32_t>(length);
+        bool written = fwrite(&magic, sizeof(magic), 1, file) == 1 && fwrite(&key, sizeof(key), 1, file) == 1 &&
+                       fwrite(&binaryFormat, sizeof(binaryFormat), 1, file) == 1 && fwrite(&size, sizeof(size), 1, file) == 1 &&
+                       fwrite(binary.data(), 1, size, file) == size;
+        written = fclose(file) == 0 && written;
+        stored = written && std::rename(temporary.c_str(), path.c_str()) == 0;
+        if (!stored) std::remove(temporary.c_str());
+        return stored;
+    }
+
+    const char* status() const {
+        if (hit) return "warm (program binary loaded)";
+        if (stored) return "cold (compiled, binary cached)";
+        if (path.empty()) return "cold (compiled, cache disabled)";
+        return supported ? "cold (compiled, binary not cached)" : "cold (compiled, no program binary support)";
+    }
+};
@@ -0,0 +1,202 @@
+#pragma once
+#include "ColliderScene.h"
+#include "FixedPoint.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Static collider geometry baked into a grid of signed distances over the
+// [-1, 1] world, with the distance gradient (the outward surface normal)
+// stored next to each distance. Baking visits every primitive once per grid
+// node; afterwards a particle's boundary test is one bilinear lookup, however
+// many segments and polygons the scene has. Negative distances are inside
+// the geometry.
+class SignedDistanceField {
+private:
+    // One grid node, the layout of an SSE register
+    struct Node {
+        float distance;
+        float gradientX, gradientY;
+        float unused;
+    };
+
+    int resolution = 0;
+    float spacing = 0.0f;
+    float inverseSpacing = 0.0f;
+    std::vector<Node> nodes;
+
+    // Closest point to (x, y) on the segment a-b
+    static void closestOnSegment(float x, float y, float ax, float ay, float bx, float by, float& cx, float& cy) {
+        float dx = bx - ax, dy = by - ay;
+        float lengthSquared = dx * dx + dy * dy;
+        float t = lengthSquared > 0.0f ? std::min(std::max(((x - ax) * dx + (y - ay) * dy) / lengthSquared, 0.0f), 1.0f) : 0.0f;
+        cx = ax + dx * t;
+        cy = ay + dy * t;
+    }
+
+    // Keeps the primitive closest to the node; the gradient points away from
+    // the surface on the outside and towards it on the inside
+    static void keepNearest(Node& node, float distance, float awayX, float awayY, float awayLength) {
+        if (distance >= node.distance) return;
+        node.distance = distance;
+        if (awayLength > 0.0f) {
+            node.gradientX = awayX / awayLength;
+            node.gradientY = awayY / awayLength;
+        }
+    }
+
+    static void bakeSegment(Node& node, float x, float y, const ColliderSegment& segment) {
+        float cx, cy;
+        closestOnSegment(x, y, segment.x0, segment.y0, segment.x1, segment.y1, cx, cy);
+        float length = std::sqrt((x - cx) * (x - cx) + (y - cy) * (y - cy));
+        keepNearest(node, length - segment.thickness * 0.5f, x - cx, y - cy, length);
+    }
+
+    static void bakePolygon(Node& node, float x, float y, const ColliderPolygon& polygon) {
+        const std::vector<float>& p = polygon.points;
+        size_t count = p.size() / 2;
+        float nearest = std::numeric_limits<float>::max();
+        float nearestX = x, nearestY = y;
+        bool inside = false;
+        for (size_t i = 0, j = count - 1; i < count; j = i++) {
+            float cx, cy;
+            closestOnSegment(x, y, p[j * 2], p[j * 2 + 1], p[i * 2], p[i * 2 + 1], cx, cy);
+            float lengthSquared = (x - cx) * (x - cx) + (y - cy) * (y - cy);
+            if (lengthSquared < nearest) {
+                nearest = lengthSquared;
+                nearestX = cx;
+                nearestY = cy;
+            }
+            // Crossing test, even-odd
+            if ((p[i * 2 + 1] > y) != (p[j * 2 + 1] > y) &&
+                x < (p[j * 2] - p[i * 2]) * (y - p[i * 2 + 1]) / (p[j * 2 + 1] - p[i * 2 + 1]) + p[i * 2]) {
+                inside = !inside;
+            }
+        }
+        float length = std::sqrt(nearest);
+        if (inside) {
+            keepNearest(node, -length, nearestX - x, nearestY - y, length);
+        } else {
+            keepNearest(node, length, x - nearestX, y - nearestY, length);
+        }
+    }
+
+public:
+    // resolution nodes per axis, the first and last on the world edges
+    void bake(const ColliderScene& scene, int resolution) {
+        nodes.clear();
+        this->resolution = 0;
+        if (!scene.hasStatic()) return;
+
+        this->resolution = resolution;
+        spacing = 2.0f / (resolution - 1);
+        inverseSpacing = 1.0f / spacing;
+        Node far = { std::numeric_limits<float>::max(), 0.0f, 1.0f, 0.0f };
+        nodes.assign(static_cast<size_t>(resolution) * resolution, far);
+        for (int row = 0; row < resolution; row++) {
+            float y = -1.0f + row * spacing;
+            for (int column = 0; column < resolution; column++) {
+                float x = -1.0f + column * spacing;
+                Node& node = nodes[static_cast<size_t>(row) * resolution + column];
+                for (const ColliderSegment& segment : scene.segments) bakeSegment(node, x, y, segment);
+                for (const ColliderPolygon& polygon : scene.polygons) bakePolygon(node, x, y, polygon);
+            }
+        }
+    }
+
+    bool isEmpty() const { return nodes.empty(); }
+    int getResolution() const { return resolution; }
+
+    // Bilinear distance and gradient at (x, y), clamped to the world; the
+    // gradient is not renormalized
+    void sample(float x, float y, float& distance, float& gradientX, float& gradientY) const {
+        float gx = std::min(std::max((x + 1.0f) * inverseSpacing, 0.0f), resolution - 1.001f);
+        float gy = std::min(std::max((y + 1.0f) * inverseSpacing, 0.0f), resolution - 1.001f);
+        int column = static_cast<int>(gx);
+        int row = static_cast<int>(gy);
+        float fx = gx - column;
+        float fy = gy - row;
+        const Node* n00 = &nodes[static_cast<size_t>(row) * resolution + column];
+        const Node* n10 = n00 + resolution;
+#if defined(__SSE2__)
+        // All three channels at once, one register per corner
+        __m128 a = _mm_loadu_ps(&n00[0].distance);
+        __m128 b = _mm_loadu_ps(&n00[1].distance);
+        __m128 c = _mm_loadu_ps(&n10[0].distance);
+        __m128 d = _mm_loadu_ps(&n10[1].distance);
+        __m128 tx = _mm_set1_ps(fx);
+        __m128 bottom = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), tx));
+        __m128 top = _mm_add_ps(c, _mm_mul_ps(_mm_sub_ps(d, c), tx));
+        float result[4];
+        _mm_storeu_ps(result, _mm_add_ps(bottom, _mm_mul_ps(_mm_sub_ps(top, bottom), _mm_set1_ps(fy))));
+        distance = result[0];
+        gradientX = result[1];
+        gradientY = result[2];
+#else
+        float result[3];
+        for (int channel = 0; channel < 3; channel++) {
+            float a = (&n00[0].distance)[channel], b = (&n00[1].distance)[channel];
+            float c = (&n10[0].distance)[channel], d = (&n10[1].distance)[channel];
+            float bottom = a + (b - a) * fx;
+            float top = c + (d - c) * fx;
+            result[channel] = bottom + (top - bottom) * fy;
+        }
+        distance = result[0];
+        gradientX = result[1];
+        gradientY = result[2];
+#endif
+    }
+
+    // Moves a particle whose center is closer than particleRadius to the
+    // surface back onto it along the normal and reflects the normal part of
+    // its velocity, scaled by damping like the box walls. The response is
+    // float math for both layouts and fixed-point positions only take the
+    // rounded correction, so their precision away from colliders is untouched.
+    template <typename Position>
+    void collide(Position* position, Position* last, float particleRadius, float damping) const {
+        float x = toWorld(position[0]);
+        float y = toWorld(position[1]);
+        float distance, normalX, normalY;
+        sample(x, y, distance, normalX, normalY);
+        if (distance >= particleRadius) return;
+
+        float length = std::sqrt(normalX * normalX + normalY * normalY);
+        if (length <= 0.0f) return;
+        normalX /= length;
+        normalY /= length;
+
+        float velocityX = toWorld(static_cast<Position>(position[0] - last[0]));
+        float velocityY = toWorld(static_cast<Position>(position[1] - last[1]));
+        float normalVelocity = velocityX * normalX + velocityY * normalY;
+        if (normalVelocity < 0.0f) {
+            velocityX -= (1.0f + damping) * normalVelocity * normalX;
+            velocityY -= (1.0f + damping) * normalVelocity * normalY;
+        }
+
+        float push = particleRadius - distance;
+        position[0] += fromWorld<Position>(normalX * push);
+        position[1] += fromWorld<Position>(normalY * push);
+        last[0] = position[0] - fromWorld<Position>(velocityX);
+        last[1] = position[1] - fromWorld<Position>(velocityY);
+    }
+
+    // The geometry drawn into an RGBA8 image, bottom-up like SoftwareRasterizer,
+    // as the background every renderer draws the particles over
+    void paint(int width, int height, uint32_t fill, uint32_t edge, uint32_t clearColor, std::vector<uint32_t>& pixels) const {
+        pixels.assign(static_cast<size_t>(width) * height, clearColor);
+        if (isEmpty()) return;
+        float edgeWidth = 2.0f / std::min(width, height) * 1.5f;
+        for (int row = 0; row < height; row++) {
+            for (int column = 0; column < width; column++) {
+                float distance, gradientX, gradientY;
+                sample((column + 0.5f) * 2.0f / width - 1.0f, (row + 0.5f) * 2.0f / height - 1.0f, distance, gradientX, gradientY);
+                if (distance <= 0.0f) pixels[static_cast<size_t>(row) * width + column] = distance > -edgeWidth ? edge : fill;
+            }
+        }
+    }
+};
@@ -0,0 +1,440 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "SimulationPolicies.h"
+#include "CollisionSolver.h"
+#include "KinematicColliders.h"
+#include "ForceField.h"
+#include "CommandQueue.h"
+#include "StateChecksum.h"
+#include "FixedPoint.h"
+#include "ThreadPool.h"
+#include "NumaPlacement.h"
+#include "PerformanceProfiler.h"
+#include <vector>
+#include <random>
+#include <memory>
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <type_traits>
+
+// Keyboard state that changes the simulation, applied after a frame's physics
+struct FrameInput {
+    bool reverseGravity = false; // W
+    bool pushLeft = false;       // D
+};
+
+// Everything that carries over when the running scene moves to another
+// pipeline; positions in world units as doubles, which both layouts
+// convert to and from exactly
+struct SimulationState {
+    std::vector<double> positions, lastPositions;
+    Acceleration acceleration;
+    std::mt19937 rng;
+    int framesSinceLastSpawn = 0;
+    float spawnIntervalMs = SPAWN_INTERVAL_MS;
+    int spawnCount = NUMBER_OF_CIRCLES_SPAWNED;
+    float damping = WALL_DAMPING;
+    int substeps = 0;
+    long long frame = 0;
+    uint64_t frameChecksum = 0;
+    CollisionMode collisionMode = COLLISION_MODE;
+    const SignedDistanceField* colliders = nullptr;
+    std::vector<KinematicCollider> kinematic;
+    CollisionEventStream* collisionEvents = nullptr;
+};
+
+// A pipeline's own position arrays, x, y per particle, for reading and
+// writing in place between steps. Both are reserved for NUMCIRCLES
+// particles when the pipeline is created, so they never move.
+struct PositionStorage {
+    void* positions = nullptr;
+    void* lastPositions = nullptr;
+    bool fixedPoint = false; // fixed_t (FIXED_ONE per world unit) instead of float
+};
+
+// State and frame-level interface shared by every pipeline. The virtual
+// calls happen a few times per frame; everything per particle is inside the
+// concrete Simulation<...>::step.
+class SimulationBase {
+protected:
+    int particleCount = 0;
+    Acceleration acceleration; // The same for every particle at the same place
+    ThreadPool threadPool;
+    CollisionMode collisionMode;
+
+    // Every random spawn attribute must come from this engine so a seed reproduces a run
+    std::mt19937 rng;
+    uint32_t seed;
+
+    int framesSinceLastSpawn = 0;
+    float spawnIntervalMs = SPAWN_INTERVAL_MS;
+    int spawnCount = NUMBER_OF_CIRCLES_SPAWNED; // Particles per automatic spawn
+    float damping = WALL_DAMPING;
+    int substeps = static_cast<int>(UPDATER_PER_FRAME);
+    long long frame = 0;
+    uint64_t frameChecksum = 0;
+    const SignedDistanceField* colliders = nullptr; // Static geometry, null for the plain box
+    KinematicColliders kinematic;                     // Moving geometry, posed by the frame count
+    CollisionEventStream* collisionEvents = nullptr;  // Impacts above its threshold, null for none
+    bool slicesSharePages = false;                    // First touch left some slice without a page of its own
+
+    // Simulated time at the end of a substep, which the kinematic colliders move by
+    double substepTime(int physicsStep) const { return (frame + (physicsStep + 1.0) / substeps) / TARGET_FPS; }
+
+public:
+    SimulationBase(int threadCount, bool pinThreads, CollisionMode mode, uint32_t seed)
+        : threadPool(threadCount, pinThreads), collisionMode(mode), rng(seed), seed(seed) {}
+
+    virtual ~SimulationBase() {}
+
+    int getParticleCount() const { return particleCount; }
+    CollisionMode getCollisionMode() const { return collisionMode; }
+    void setCollisionMode(CollisionMode mode) { collisionMode = mode; }
+    // Baked before the first step; an empty field is the same as none
+    void setColliders(const SignedDistanceField* field) { colliders = field && !field->isEmpty() ? field : nullptr; }
+    void setKinematicColliders(const std::vector<KinematicCollider>& definitions) {
+        kinematic.setColliders(definitions);
+        kinematic.update(substepTime(-1), getStepTime(), radius);
+    }
+    // An empty field is the same as none
+    void setForceField(const ForceField* field) { acceleration.field = field && !field->isEmpty() ? field : nullptr; }
+    // Consumed on another thread; must have a ring for every thread of this pipeline
+    void setCollisionEvents(CollisionEventStream* stream) { collisionEvents = stream; }
+    // Posed as of the end of the latest step, for drawing
+    const KinematicColliders& getKinematicColliders() const { return kinematic; }
+    int getThreadCount() const { return threadPool.getThreadCount(); }
+    // Idle between steps, when the software rasterizer borrows it
+    ThreadPool& getThreadPool() { return threadPool; }
+    int getSubsteps() const { return substeps; }
+
+    // Physics step length; the substeps always cover one rendered frame
+    float getStepTime() const { return (1.0f / TARGET_FPS) / substeps; }
+
+    uint32_t getSeed() const { return seed; }
+    long long getFrame() const { return frame; }
+    uint64_t getChecksum() const { return frameChecksum; }
+
+    // Thread to CPU/node placement, printed once at startup
+    void printPlacement() const {
+        NumaTopology topology;
+        std::cout << "Threads: " << threadPool.getThreadCount() << " over " << topology.getNodeCount() << " NUMA node(s)";
+        if (threadPool.getThreadCpu(0) < 0) {
+            std::cout << ", not pinned" << std::endl;
+            return;
+        }
+        std::cout << ", pinned:";
+        for (int thread = 0; thread < threadPool.getThreadCount(); thread++) {
+            int cpu = threadPool.getThreadCpu(thread);
+            std::cout << " " << thread << "->cpu" << cpu << "/node" << topology.nodeOfCpu(cpu);
+        }
+        std::cout << std::endl;
+        if (slicesSharePages && topology.getNodeCount() > 1) {
+            std::cout << "Warning: " << particleArena().getPageSize() / 1024 << " KB " << pageModeName(particleArena().getPageMode())
+                      << " pages hold several threads' whole particle slices, which then live on another thread's node;"
+                      << " --pages 4k places each slice on its own" << std::endl;
+        }
+    }
+
+    // Spawns of getSpawnCount() particles are due every spawn interval of simulated time until NUMCIRCLES exist
+    bool spawnDue() const {
+        const int framesPerSpawn = static_cast<int>((spawnIntervalMs / 1000.0f) * TARGET_FPS); // Convert ms to frames
+        return spawnCount > 0 && getParticleCount() < NUMCIRCLES && framesSinceLastSpawn >= framesPerSpawn;
+    }
+    int getSpawnCount() const { return spawnCount; }
+    float getSpawnInterval() const { return spawnIntervalMs; }
+    float getDamping() const { return damping; }
+
+    float getGravityX() const { return acceleration.gravityX; }
+    float getGravityY() const { return acceleration.gravityY; }
+    void setGravity(float x, float y) {
+        acceleration.gravityX = x;
+        acceleration.gravityY = y;
+    }
+
+    // Keys change the scene-wide gravity, no particle is touched
+    void applyInput(const FrameInput& input) {
+        if (input.reverseGravity) acceleration.gravityY = -acceleration.gravityY;
+        if (input.pushLeft) acceleration.gravityX = -5.0f;
+    }
+
+    // A queued command (CommandQueue.h), applied between frames like the keys.
+    // Spawn commands must carry their layout height by now.
+    void applyCommand(const Command& command) {
+        switch (command.type) {
+            case CommandType::Gravity: setGravity(command.x, command.y); break;
+            case CommandType::Damping: damping = command.value; break;
+            case CommandType::SpawnInterval: spawnIntervalMs = command.value; break;
+            case CommandType::SpawnCount: spawnCount = command.count; break;
+            case CommandType::Spawn: spawn(command.count, command.layoutHeight); break;
+            case CommandType::Remove: removeInCircle(command.x, command.y, command.value); break;
+            case CommandType::CollisionMode: collisionMode = static_cast<CollisionMode>(command.count); break;
+            case CommandType::Substeps: setSubsteps(command.count); break;
+        }
+    }
+
+    // Copies the scene out of this pipeline and into another one between
+    // frames, so backends can be compared on the same live state. Same-layout
+    // moves are exact; between layouts the positions round to the target's precision.
+    void saveState(SimulationState& state) {
+        state.acceleration = acceleration;
+        state.rng = rng;
+        state.framesSinceLastSpawn = framesSinceLastSpawn;
+        state.spawnIntervalMs = spawnIntervalMs;
+        state.spawnCount = spawnCount;
+        state.damping = damping;
+        state.substeps = substeps;
+        state.frame = frame;
+        state.frameChecksum = frameChecksum;
+        state.collisionMode = collisionMode;
+        state.colliders = colliders;
+        state.kinematic = kinematic.getColliders();
+        state.collisionEvents = collisionEvents;
+        savePositions(state.positions, state.lastPositions);
+    }
+
+    void restoreState(const SimulationState& state) {
+        acceleration = state.acceleration;
+        particleCount = static_cast<int>(state.positions.size() / 2);
+        rng = state.rng;
+        framesSinceLastSpawn = state.framesSinceLastSpawn;
+        spawnIntervalMs = state.spawnIntervalMs;
+        spawnCount = state.spawnCount;
+        damping = state.damping;
+        substeps = state.substeps;
+        frame = state.frame;
+        frameChecksum = state.frameChecksum;
+        collisionMode = state.collisionMode;
+        colliders = state.colliders;
+        setKinematicColliders(state.kinematic);
+        collisionEvents = state.collisionEvents;
+        restorePositions(state.positions, state.lastPositions);
+    }
+
+    virtual const char* getLayoutName() const = 0;
+    virtual const char* getIntegratorName() const = 0;
+
+    // Adds a column of circles at the top left. layoutHeight is the window height
+    // the column is spaced for, so it is part of the spawn event.
+    virtual void spawn(int count, int layoutHeight) = 0;
+
+    // Drops every particle centered within r of (x, y), keeping the others in
+    // order; returns how many went
+    virtual int removeInCircle(float x, float y, float r) = 0;
+
+    // One rendered frame: getSubsteps() substeps of integration, walls and collisions
+    virtual void step() = 0;
+
+    // Substeps per frame from the next step on, a power of two up to UPDATER_PER_FRAME
+    virtual void setSubsteps(int count) = 0;
+
+    // Positions as floats for the GL buffer, valid until the next step
+    virtual const float* getWorldPositions() = 0;
+
+    // Positions one step earlier; (position - last) / getStepTime() is the
+    // velocity under uniform stepping. Under multirate a particle on level L
+    // covers that displacement in 2^L substeps, so for coarse particles this
+    // overstates its simulated-time velocity by 2^L (see LocalTimeStepping.h)
+    virtual const float* getWorldLastPositions() = 0;
+
+    // Broad-phase grid of the last collision pass of the latest step
+    virtual const SpatialGrid& getGrid() = 0;
+
+    virtual PositionStorage getPositionStorage() = 0;
+
+    virtual void printStats() = 0;
+
+protected:
+    virtual void savePositions(std::vector<double>& world, std::vector<double>& lastWorld) const = 0;
+    virtual void restorePositions(const std::vector<double>& world, const std::vector<double>& lastWorld) = 0;
+};
+
+// One physics pipeline, composed at compile time:
+//   Layout      position storage (FloatLayout, FixedLayout)
+//   BroadPhase  spatial binning (UniformGridBroadPhase)
+//   Solver      particle contacts over the broad phase (CollisionSolver)
+//   Integrator  Verlet step and walls (MultiRateVerlet, UniformVerlet)
+// The config constants (radius, substeps, walls) are compile-time as well, so
+// each instantiation is specialized all the way down to the contact kernel.
+template <typename Layout, typename BroadPhase, template <typename> class Solver, typename Integrator>
+class Simulation : public SimulationBase {
+private:
+    typedef typename Layout::Position Position;
+
+    ArenaVector<Position> positions, lastPositions;
+    ArenaVector<int> steppingParticles;
+    ArenaVector<float> worldPositions, worldLastPositions;
+
+    BroadPhase broadPhase;
+    Solver<Position> solver;
+    Integrator integrator;
+
+public:
+    Simulation(int threadCount, bool pinThreads, CollisionMode mode, uint32_t seed)
+        : SimulationBase(threadCount, pinThreads, mode, seed), solver(radius, precision) {
+        positions.reserve(NUMCIRCLES * 2);
+        lastPositions.reserve(NUMCIRCLES * 2);
+
+        // Each thread's slice of the particle arrays lands on that thread's node,
+        // as far as the arena's page size allows
+        size_t pageSize = particleArena().getPageSize();
+        bool positionsLocal = firstTouch(threadPool, positions.data(), 2 * sizeof(Position), NUMCIRCLES, pageSize);
+        bool lastPositionsLocal = firstTouch(threadPool, lastPositions.data(), 2 * sizeof(Position), NUMCIRCLES, pageSize);
+        slicesSharePages = !positionsLocal || !lastPositionsLocal;
+    }
+
+    const char* getLayoutName() const override { return Layout::name(); }
+    const char* getIntegratorName() const override { return Integrator::name(); }
+
+    void spawn(int count, int layoutHeight) override {
+        for (int i = 0; i < count && getParticleCount() < NUMCIRCLES; i++) {
+            float x = -0.95f;
+            float y = 0.95f - layoutHeight * (i * radius) * 0.005f;
+            positions.push_back(fromWorld<Position>(x));
+            positions.push_back(fromWorld<Position>(y));
+
+            // setting up velocity this way we use the formula (xn - x(n-1))/deltaT = v
+            lastPositions.push_back(fromWorld<Position>(x) - fromWorld<Position>(velocityX * getStepTime()));
+            lastPositions.push_back(fromWorld<Position>(y) + fromWorld<Position>(velocityY * getStepTime()));
+            particleCount++;
+        }
+        framesSinceLastSpawn = 0;
+    }
+
+    int removeInCircle(float x, float y, float r) override {
+        int kept = 0;
+        for (int i = 0; i < particleCount; i++) {
+            float dx = toWorld(positions[i * 2]) - x;
+            float dy = toWorld(positions[i * 2 + 1]) - y;
+            if (dx * dx + dy * dy <= r * r) continue;
+            positions[kept * 2] = positions[i * 2];
+            positions[kept * 2 + 1] = positions[i * 2 + 1];
+            lastPositions[kept * 2] = lastPositions[i * 2];
+            lastPositions[kept * 2 + 1] = lastPositions[i * 2 + 1];
+            kept++;
+        }
+        int removed = particleCount - kept;
+        positions.resize(kept * 2);
+        lastPositions.resize(kept * 2);
+        particleCount = kept;
+        return removed;
+    }
+
+    void step() override {
+        int activeParticles = getParticleCount();
+        float stepTime = getStepTime();
+
+        integrator.beginFrame(broadPhase.getGrid(), positions, lastPositions, acceleration, activeParticles, stepTime, substeps);
+        solver.setEventStream(collisionEvents, static_cast<uint32_t>(frame), stepTime);
+
+        for (int physicsStep = 0; physicsStep < substeps; physicsStep++) {
+            // Update positions based on Verlet integration
+            {
+                PROFILE_SCOPE(g_profiler, "Verlet Integration");
+                integrator.integrate(threadPool, positions, lastPositions, acceleration, activeParticles, physicsStep, stepTime,
+                                     steppingParticles);
+            }
+
+            // Wall collisions (after position update)
+            {
+                PROFILE_SCOPE(g_profiler, "Wall Collisions");
+                integrator.applyWalls(threadPool, positions, lastPositions, activeParticles, physicsStep, colliders, damping);
+            }
+
+            //Collision between objects using spatial grid optimization
+            {
+                PROFILE_SCOPE(g_profiler, collisionScopeName(collisionMode));
+                broadPhase.build(positions, activeParticles);
+
+                // Only pairs with at least one particle stepping on this substep are resolved
+                solver.solve(collisionMode, threadPool, broadPhase.getGrid(), positions, integrator.getTimeLevels(),
+                             physicsStep, steppingParticles);
+            }
+
+            // Moving colliders last, so they win over the contacts; only the cells they sweep are visited
+            if (!kinematic.empty()) {
+                PROFILE_SCOPE(g_profiler, "Kinematic Colliders");
+                kinematic.update(substepTime(physicsStep), stepTime, radius);
+                kinematic.collide(threadPool, broadPhase.getGrid(), positions, lastPositions, activeParticles, radius, damping);
+            }
+        }
+
+        // Per-frame state checksum for comparing runs across thread counts and modes
+        frameChecksum = stateChecksum(positions, lastPositions, activeParticles);
+        framesSinceLastSpawn++;
+        frame++;
+    }
+
+    void setSubsteps(int count) override {
+        if (count == substeps) return;
+
+        // Verlet velocity is the displacement over one step, so it is rescaled to the new step length
+        double scale = static_cast<double>(substeps) / count;
+        for (size_t i = 0; i < positions.size(); i++) {
+            lastPositions[i] = positions[i] - scaleDisplacement(positions[i] - lastPositions[i], scale);
+        }
+        substeps = count;
+    }
+
+    const float* getWorldPositions() override {
+        return Layout::worldPositions(positions, worldPositions);
+    }
+
+    const float* getWorldLastPositions() override {
+        return Layout::worldPositions(lastPositions, worldLastPositions);
+    }
+
+    const SpatialGrid& getGrid() override { return broadPhase.getGrid(); }
+
+    PositionStorage getPositionStorage() override {
+        PositionStorage storage;
+        storage.positions = positions.data();
+        storage.lastPositions = lastPositions.data();
+        storage.fixedPoint = std::is_same<Position, fixed_t>::value;
+        return storage;
+    }
+
+protected:
+    void savePositions(std::vector<double>& world, std::vector<double>& lastWorld) const override {
+        world.resize(positions.size());
+        lastWorld.resize(lastPositions.size());
+        for (size_t i = 0; i < positions.size(); i++) {
+            world[i] = toWorldExact(positions[i]);
+            lastWorld[i] = toWorldExact(lastPositions[i]);
+        }
+    }
+
+    void restorePositions(const std::vector<double>& world, const std::vector<double>& lastWorld) override {
+        positions.resize(world.size());
+        lastPositions.resize(lastWorld.size());
+        for (size_t i = 0; i < world.size(); i++) {
+            positions[i] = fromWorldExact<Position>(world[i]);
+            lastPositions[i] = fromWorldExact<Position>(lastWorld[i]);
+        }
+    }
+
+public:
+
+    void printStats() override {
+        integrator.printStats();
+        kinematic.printStats();
+        printCollisionModeComparison(g_profiler);
+        printf("State Checksum: frame %lld 0x%016llx (%d threads, %s/%s)\n", frame,
+               static_cast<unsigned long long>(frameChecksum), threadPool.getThreadCount(),
+               Layout::name(), Integrator::name());
+    }
+};
+
+// Picks one of the pre-instantiated pipelines by layout and integrator name.
+// Returns null for an unknown combination.
+std::unique_ptr<SimulationBase> createSimulation(const std::string& layout, const std::string& integrator,
+                                                 int threadCount, bool pinThreads, CollisionMode mode, uint32_t seed);
+
+// "layout/integrator" names of every available pipeline, for usage messages
+std::string availableSimulations();
+
+// The next layout compiled in with this integrator (or integrator with this
+// layout), wrapping around; the same name when there is no other
+std::string nextLayout(const std::string& layout, const std::string& integrator);
+std::string nextIntegrator(const std::string& layout, const std::string& integrator);
@@ -0,0 +1,93 @@
+#pragma once
+#include "CollisionSolver.h"
+#include "HugePageArena.h"
+
+const int NUMCIRCLES = 3800; // Number of circles to simulate
+const float radius = 0.008f;
+
+// Circle spawning settings, the defaults of the spawn_interval and spawn_count commands
+const float SPAWN_INTERVAL_MS = 10.0f;
+const int NUMBER_OF_CIRCLES_SPAWNED = 10;
+const float precision = radius * radius * 0.1f; // Precision for distance calculations
+
+// Frame rate limiting variables
+const float TARGET_FPS = 60.0f;
+const float UPDATER_PER_FRAME = 8.0f;
+const float deltaTime = (1.0f / TARGET_FPS) / UPDATER_PER_FRAME;
+const int FRAME_SPIN_MARGIN_US = 1500; // Busy-wait this long before each frame deadline (FramePacer.h)
+const bool REALTIME_SCHEDULING = false; // SCHED_FIFO render thread and mlockall (--realtime)
+const int REALTIME_PRIORITY = 10;
+const bool GPU_TIME_SWAP = true; // GPU timer scope around glfwSwapBuffers (GpuTimer.h)
+
+// Quality governor (QualityGovernor.h), steps quality down when a frame's work exceeds the budget
+const bool QUALITY_GOVERNOR = false; // --governor enables it; off by default since fewer substeps change the physics
+const float FRAME_BUDGET_MS = 1000.0f / TARGET_FPS * 0.85f; // Leaves the rest of the frame for swap and pacing
+const float GOVERNOR_RESTORE_FRACTION = 0.6f; // Step back up when the predicted cost is below this part of the budget
+const int GOVERNOR_SETTLE_FRAMES = 60; // Frames after a change before the averages are trusted again
+const int STATS_INTERVAL_SECONDS = 5;
+const int CIRCLE_LOD_SEGMENTS[] = { 32, 16, 8 }; // Triangles per circle for each render LOD
+
+// Particle drawing: "gl" (instanced circles), "software" (SoftwareRasterizer.h)
+// or "density" (DensityRenderer.h), --renderer
+const char* const DEFAULT_RENDERER = "gl";
+const int RASTER_TILE_SIZE = 32; // Pixels per side of a software rasterizer tile
+const int DENSITY_BANDS_PER_THREAD = 4; // Pixel row bands per thread when splatting the heatmap
+const bool HUD_VISIBLE = false; // Performance overlay (Hud.h), H toggles
+const int HUD_GRAPH_FRAMES = 120; // Frames in the HUD's frame-time graph
+const char* const SHADER_CACHE_FILE = "particle_sim_shaders.bin"; // Linked program binary (ShaderCache.h), --no-shader-cache
+const bool VELOCITY_COLORING = true; // GL circles colored by speed in the vertex shader
+const float SPEED_COLOR_MAX = 4.0f; // Speed (world units per second) at the hot end of the color ramp
+
+// Pipeline used unless --layout / --integrator pick another (see SimulationFactory.cpp)
+#ifdef PARTICLE_SIM_FIXED_POINT
+const char* const DEFAULT_LAYOUT = "fixed";
+#else
+const char* const DEFAULT_LAYOUT = "float";
+#endif
+// Every particle on every substep; "multirate" is opt-in since its coarse
+// levels run in slow motion (LocalTimeStepping.h)
+const char* const DEFAULT_INTEGRATOR = "uniform";
+const char* const DEFAULT_SCENE = "box"; // Static colliders (ColliderScene.h), --scene
+const int SDF_RESOLUTION = 256; // Collider distance field nodes per axis (SignedDistanceField.h)
+const char* const DEFAULT_FORCE_FIELD = "none"; // Vector field added to gravity (ForceField.h), --field
+const int FORCE_FIELD_RESOLUTION = 64; // Nodes per axis of the built-in force fields
+const int AB_SWITCH_FRAMES = 300; // --ab moves to the next listed pipeline every this many frames
+
+// Collision event stream (CollisionEvents.h), --events / --event-impulse
+const float COLLISION_EVENT_IMPULSE = 1.25f; // Pair impulse (unit masses, world units per second) an event needs
+const int COLLISION_EVENT_RING_SIZE = 4096; // Events per solver thread the consumer may fall behind by
+const int COLLISION_EVENT_POLL_US = 1000; // Consumer sleep when every ring is empty
+
+// In-situ analytics (GridAnalytics.h), --analytics / --analytics-interval
+const int ANALYTICS_INTERVAL_FRAMES = 30; // Frames between analytics passes
+const int ANALYTICS_CELLS_PER_BIN = 8; // Broad phase cells per analytics block side
+const float ANALYTICS_CONTACT_DISTANCE = radius * 2.1f; // Center distance counted as touching for the coordination number
+
+// External control (CommandQueue.h, CommandSources.h), --control / --config
+const int COMMAND_QUEUE_SIZE = 256; // Commands producers may queue between two frames
+const int CONFIG_POLL_MS = 250; // Config file modification time check
+const int CONTROL_POLL_MS = 100; // Control socket wait, how long stopping it may take
+
+// Multi-rate local time stepping (UPDATER_PER_FRAME must be 1 << MAX_TIME_LEVEL,
+// levels are capped when the quality governor lowers the substeps)
+const int MAX_TIME_LEVEL = 3;
+const float MAX_STEP_DISPLACEMENT = radius * 0.25f; // Max travel of a particle over one level period
+
+// Collision threading (press M to cycle modes at runtime). Deterministic by
+// default so runs and recordings reproduce on any thread count; Parallel is
+// faster but opt-in (M, "mode parallel", psim_config.collision_mode)
+const CollisionMode COLLISION_MODE = CollisionMode::Deterministic;
+const int WORKER_THREADS = 0; // 0 = one per hardware thread
+const bool PIN_THREADS = false; // Pin threads to CPUs node by node (--pin)
+const int PARALLEL_PARTICLES_PER_THREAD = 512; // Integration and walls go parallel once every thread gets this many particles
+
+// Particle and grid storage (HugePageArena.h), only the touched pages are backed
+const size_t ARENA_BYTES = 64u << 20;
+const PageMode ARENA_PAGE_MODE = PageMode::Transparent; // --pages 4k|thp|hugetlb
+
+//spawning velocity
+const float velocityX = 3.1f; // X velocity for spawning circles
+const float velocityY = 1.0f; // Y velocity for spawning circles
+
+// Part of the normal speed walls and colliders give back on a bounce (damping command)
+const float WALL_DAMPING = 0.55f;
@@ -0,0 +1,75 @@
+#include "Simulation.h"
+
+namespace {
+
+typedef SimulationBase* (*SimulationCreator)(int threadCount, bool pinThreads, CollisionMode mode, uint32_t seed);
+
+template <typename Layout, typename Integrator>
+SimulationBase* createPipeline(int threadCount, bool pinThreads, CollisionMode mode, uint32_t seed) {
+    return new Simulation<Layout, UniformGridBroadPhase, CollisionSolver, Integrator>(threadCount, pinThreads, mode, seed);
+}
+
+struct SimulationEntry {
+    const char* layout;
+    const char* integrator;
+    SimulationCreator create;
+};
+
+// Every combination that is compiled in
+const SimulationEntry SIMULATIONS[] = {
+    { FloatLayout::name(), MultiRateVerlet::name(), createPipeline<FloatLayout, MultiRateVerlet> },
+    { FloatLayout::name(), UniformVerlet::name(), createPipeline<FloatLayout, UniformVerlet> },
+    { FixedLayout::name(), MultiRateVerlet::name(), createPipeline<FixedLayout, MultiRateVerlet> },
+    { FixedLayout::name(), UniformVerlet::name(), createPipeline<FixedLayout, UniformVerlet> },
+};
+
+const int SIMULATION_COUNT = sizeof(SIMULATIONS) / sizeof(SIMULATIONS[0]);
+
+// Index of the entry after (layout, integrator) that keeps one of the two names
+// and changes the other, or -1
+int nextEntry(const std::string& layout, const std::string& integrator, bool changeLayout) {
+    int current = 0;
+    while (current < SIMULATION_COUNT &&
+           (layout != SIMULATIONS[current].layout || integrator != SIMULATIONS[current].integrator)) {
+        current++;
+    }
+    for (int offset = 1; offset < SIMULATION_COUNT; offset++) {
+        const SimulationEntry& entry = SIMULATIONS[(current + offset) % SIMULATION_COUNT];
+        if (changeLayout ? (integrator == entry.integrator && layout != entry.layout)
+                         : (layout == entry.layout && integrator != entry.integrator)) {
+            return (current + offset) % SIMULATION_COUNT;
+        }
+    }
+    return -1;
+}
+
+}
+
+std::unique_ptr<SimulationBase> createSimulation(const std::string& layout, const std::string& integrator,
+                                                 int threadCount, bool pinThreads, CollisionMode mode, uint32_t seed) {
+    for (const SimulationEntry& entry : SIMULATIONS) {
+        if (layout == entry.layout && integrator == entry.integrator) {
+            return std::unique_ptr<SimulationBase>(entry.create(threadCount, pinThreads, mode, seed));
+        }
+    }
+    return std::unique_ptr<SimulationBase>();
+}
+
+std::string availableSimulations() {
+    std::string names;
+    for (const SimulationEntry& entry : SIMULATIONS) {
+        if (!names.empty()) names += ", ";
+        names += std::string(entry.layout) + "/" + entry.integrator;
+    }
+    return names;
+}
+
+std::string nextLayout(const std::string& layout, const std::string& integrator) {
+    int next = nextEntry(layout, integrator, true);
+    return next < 0 ? layout : SIMULATIONS[next].layout;
+}
+
+std::string nextIntegrator(const std::string& layout, const std::string& integrator) {
+    int next = nextEntry(layout, integrator, false);
+    return next < 0 ? integrator : SIMULATIONS[next].integrator;
+}
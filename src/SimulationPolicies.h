@@ -0,0 +1,253 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "SpatialGrid.h"
+#include "LocalTimeStepping.h"
+#include "SignedDistanceField.h"
+#include "ForceField.h"
+#include "FixedPoint.h"
+#include "PerformanceProfiler.h"
+#include "ThreadPool.h"
+#include "NumaPlacement.h"
+#include <vector>
+
+// Policies for Simulation<Layout, BroadPhase, Solver, Integrator>. They are
+// plain types called directly from the step function, so every combination
+// compiles into its own pipeline with no virtual calls inside a frame.
+
+// ===== Layouts: position storage =====
+
+struct FloatLayout {
+    typedef float Position;
+    static const char* name() { return "float"; }
+
+    // Positions for the GL buffer, uploaded as they are
+    static const float* worldPositions(const ArenaVector<float>& positions, ArenaVector<float>&) {
+        return positions.data();
+    }
+};
+
+struct FixedLayout {
+    typedef fixed_t Position;
+    static const char* name() { return "fixed"; }
+
+    static const float* worldPositions(const ArenaVector<fixed_t>& positions, ArenaVector<float>& world) {
+        world.resize(positions.size());
+        convertToWorld(positions.data(), world.data(), static_cast<int>(positions.size()));
+        return world.data();
+    }
+};
+
+// ===== Broad phase =====
+
+// Uniform grid rebuilt from scratch every substep
+class UniformGridBroadPhase {
+private:
+    SpatialGrid grid;
+
+public:
+    UniformGridBroadPhase() : grid(radius * 2.2f, -1.0f, -1.0f, 1.0f, 1.0f) {} // Optimal cell size
+
+    static const char* name() { return "grid"; }
+
+    template <typename Position>
+    void build(const ArenaVector<Position>& positions, int count) {
+        grid.clear();
+        for (int i = 0; i < count; i++) {
+            grid.addParticle(i, toWorld(positions[i * 2]), toWorld(positions[i * 2 + 1]));
+        }
+    }
+
+    SpatialGrid& getGrid() { return grid; }
+};
+
+// ===== Integrators =====
+
+// Verlet integration, box walls and static colliders. TimeLevels decides which particles step
+// on a substep; the float and fixed-point kernels are picked by overload.
+template <typename TimeLevels>
+class VerletIntegrator {
+private:
+    TimeLevels timeLevels;
+    ArenaVector<fixed_t> accelerationSteps; // a*dt^2 in fixed point, per particle when there is a field
+    fixed_t gravitySteps[2];                // gravity*dt^2 in fixed point, refreshed every frame
+
+    const float wallLeft = -1.0f + radius;
+    const float wallRight = 1.0f - radius;
+    const float wallBottom = -1.0f + radius;
+    const float wallTop = 1.0f - radius;
+
+    std::vector<ArenaVector<int>> threadStepping; // Stepping particles of each thread's range
+
+    // Per-particle phases run on the stable particle slices of NumaPlacement.h,
+    // so each thread keeps working on the memory it first touched. Small
+    // counts run as one slice on the calling thread.
+    template <typename Body>
+    void forEachRange(ThreadPool& pool, int count, const Body& body) {
+        if (count < PARALLEL_PARTICLES_PER_THREAD * pool.getThreadCount()) {
+            threadStepping.resize(1);
+            body(0, 0, count);
+            return;
+        }
+        int threads = pool.getThreadCount();
+        threadStepping.resize(threads);
+        pool.forEachThread([&](int thread) {
+            int begin, end;
+            stableRange(thread, threads, NUMCIRCLES, count, begin, end);
+            body(thread, begin, end);
+        });
+    }
+
+    // Slices are ascending, so concatenating them keeps the particle order
+    void mergeStepping(ArenaVector<int>& steppingParticles) {
+        steppingParticles.clear();
+        for (const ArenaVector<int>& stepping : threadStepping) {
+            steppingParticles.insert(steppingParticles.end(), stepping.begin(), stepping.end());
+        }
+    }
+
+    void prepareAcceleration(const Acceleration&, int, float, float) {}
+
+    // Gravity and the step length can change between frames, so g*dt^2 is converted once per frame
+    void prepareAcceleration(const Acceleration& acceleration, int count, float stepTime, fixed_t) {
+        gravitySteps[0] = toFixed(static_cast<double>(acceleration.gravityX) * stepTime * stepTime);
+        gravitySteps[1] = toFixed(static_cast<double>(acceleration.gravityY) * stepTime * stepTime);
+        if (acceleration.field) accelerationSteps.resize(count * 2);
+    }
+
+public:
+    explicit VerletIntegrator(const TimeLevels& timeLevels) : timeLevels(timeLevels) {}
+
+    const TimeLevels& getTimeLevels() const { return timeLevels; }
+
+    void printStats() { timeLevels.printStats(); }
+
+    // All time levels are synchronized at the frame boundary
+    template <typename Position>
+    void beginFrame(const SpatialGrid& grid, const ArenaVector<Position>& positions, const ArenaVector<Position>& lastPositions,
+                    const Acceleration& acceleration, int count, float stepTime, int substeps) {
+        {
+            PROFILE_SCOPE(g_profiler, "Time Level Assignment");
+            timeLevels.assignLevels(grid, positions, lastPositions, acceleration, count, stepTime, substeps);
+        }
+        prepareAcceleration(acceleration, count, stepTime, Position());
+    }
+
+    // The field is sampled where the particle is before the step; without one
+    // every particle takes the same gravity, with no per-particle acceleration data
+    void integrate(ThreadPool& pool, ArenaVector<float>& positions, ArenaVector<float>& lastPositions,
+                   const Acceleration& acceleration, int count, int step, float stepTime,
+                   ArenaVector<int>& steppingParticles) {
+        forEachRange(pool, count, [&](int thread, int begin, int end) {
+            ArenaVector<int>& stepping = threadStepping[thread];
+            stepping.clear();
+            for (int i = begin; i < end; i++){
+                // Particles on a coarse time level only move every 2^level substeps
+                if (!timeLevels.isActive(i, step)) continue;
+                stepping.push_back(i);
+
+                // Store current position as next frame's lastPosition
+                float tempX = positions[i * 2];
+                float tempY = positions[i * 2 + 1];
+
+                float ax = acceleration.gravityX, ay = acceleration.gravityY;
+                if (acceleration.field) acceleration.at(tempX, tempY, ax, ay);
+
+                // Verlet integration: x(n+1) = 2*x(n) - x(n-1) + a*dt^2
+                positions[i * 2] = 2.0f * positions[i * 2] - lastPositions[i * 2] + ax * stepTime * stepTime;
+                positions[i * 2 + 1] = 2.0f * positions[i * 2 + 1] - lastPositions[i * 2 + 1] + ay * stepTime * stepTime;
+
+                // Update lastPositions for next frame
+                lastPositions[i * 2] = tempX;
+                lastPositions[i * 2 + 1] = tempY;
+            }
+        });
+        mergeStepping(steppingParticles);
+        timeLevels.recordSubstep(steppingParticles.size(), count);
+    }
+
+    // With a field, a*dt^2 of every stepping particle is converted to fixed point first
+    void integrate(ThreadPool& pool, ArenaVector<fixed_t>& positions, ArenaVector<fixed_t>& lastPositions,
+                   const Acceleration& acceleration, int count, int step, float stepTime, ArenaVector<int>& steppingParticles) {
+        const float stepScale = static_cast<float>(stepTime * stepTime * FIXED_ONE);
+        forEachRange(pool, count, [&](int thread, int begin, int end) {
+            ArenaVector<int>& stepping = threadStepping[thread];
+            stepping.clear();
+            for (int i = begin; i < end; i++) {
+                if (timeLevels.isActive(i, step)) stepping.push_back(i);
+            }
+            if (!acceleration.field) {
+                integrateFixed(positions.data(), lastPositions.data(), gravitySteps, 0, timeLevels, step, begin, end);
+                return;
+            }
+            for (int i : stepping) {
+                float ax, ay;
+                acceleration.at(toWorld(positions[i * 2]), toWorld(positions[i * 2 + 1]), ax, ay);
+                toFixedScaled(ax, ay, stepScale, &accelerationSteps[i * 2]);
+            }
+            integrateFixed(positions.data(), lastPositions.data(), accelerationSteps.data(), 2, timeLevels, step, begin, end);
+        });
+        mergeStepping(steppingParticles);
+        timeLevels.recordSubstep(steppingParticles.size(), count);
+    }
+
+    // Static colliders (null for none) are tested in the same pass, right after the box;
+    // damping can change between frames
+    void applyWalls(ThreadPool& pool, ArenaVector<float>& positions, ArenaVector<float>& lastPositions, int count, int,
+                    const SignedDistanceField* colliders, float damping) {
+        forEachRange(pool, count, [&](int thread, int, int) {
+            for (int i : threadStepping[thread]) {
+                // Bounce off left and right walls
+                if(positions[i * 2] <= wallLeft) {
+                    // For Verlet integration, reverse velocity by reflecting lastPosition
+                    lastPositions[i * 2] = wallLeft + (positions[i * 2] - lastPositions[i * 2]) * damping;
+                    positions[i * 2] = wallLeft;
+                }
+                else if(positions[i * 2] >= wallRight) {
+                    // Reverse velocity: subtract the velocity difference instead of adding
+                    lastPositions[i * 2] = wallRight + (positions[i * 2] - lastPositions[i * 2]) * damping;
+                    positions[i * 2] = wallRight;
+                }
+
+                // Bounce off top and bottom walls
+                if(positions[i * 2 + 1] <= wallBottom) {
+                    lastPositions[i * 2 + 1] = wallBottom + (positions[i * 2 + 1] - lastPositions[i * 2 + 1]) * damping;
+                    positions[i * 2 + 1] = wallBottom;
+
+                }else if(positions[i * 2 + 1] >= wallTop) {
+                    lastPositions[i * 2 + 1] = wallTop + (positions[i * 2 + 1] - lastPositions[i * 2 + 1]) * damping;
+                    positions[i * 2 + 1] = wallTop;
+                }
+
+                if (colliders) colliders->collide(&positions[i * 2], &lastPositions[i * 2], radius, damping);
+            }
+        });
+    }
+
+    void applyWalls(ThreadPool& pool, ArenaVector<fixed_t>& positions, ArenaVector<fixed_t>& lastPositions, int count, int step,
+                    const SignedDistanceField* colliders, float damping) {
+        const int32_t dampingQ8 = static_cast<int32_t>(damping * 256.0f + 0.5f);
+        forEachRange(pool, count, [&](int thread, int begin, int end) {
+            applyWallsFixed(positions.data(), lastPositions.data(), timeLevels, step, begin, end,
+                            toFixed(wallLeft), toFixed(wallRight), dampingQ8);
+            if (!colliders) return;
+            // The slice's stepping particles, collected by integrate
+            for (int i : threadStepping[thread]) {
+                colliders->collide(&positions[i * 2], &lastPositions[i * 2], radius, damping);
+            }
+        });
+    }
+};
+
+// Per-region power-of-two substeps (see LocalTimeStepping.h)
+class MultiRateVerlet : public VerletIntegrator<LocalTimeStepping> {
+public:
+    MultiRateVerlet() : VerletIntegrator<LocalTimeStepping>(LocalTimeStepping(MAX_TIME_LEVEL, MAX_STEP_DISPLACEMENT)) {}
+    static const char* name() { return "multirate"; }
+};
+
+// Every particle on every substep
+class UniformVerlet : public VerletIntegrator<UniformTimeStepping> {
+public:
+    UniformVerlet() : VerletIntegrator<UniformTimeStepping>(UniformTimeStepping()) {}
+    static const char* name() { return "uniform"; }
+};
@@ -0,0 +1,182 @@
+#pragma once
+#include "SimulationConfig.h"
+#include "ThreadPool.h"
+#include "NumaPlacement.h"
+#include "PerformanceProfiler.h"
+#include <cstdint>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// One RGBA8 pixel from a [0, 1] color; little-endian, so the bytes are R, G, B, A
+inline uint32_t packRgba8(float r, float g, float b) {
+    uint32_t rgba[3];
+    const float channels[3] = { r, g, b };
+    for (int i = 0; i < 3; i++) {
+        rgba[i] = static_cast<uint32_t>(std::min(std::max(channels[i], 0.0f), 1.0f) * 255.0f + 0.5f);
+    }
+    return rgba[0] | (rgba[1] << 8) | (rgba[2] << 16) | 0xff000000u;
+}
+
+// Filled circles rasterized on the CPU into an RGBA8 image, the same picture
+// the instanced GL path draws (a pixel is covered when its center is inside
+// the circle). On machines without a GPU this beats pushing every circle's
+// triangles through a software GL driver.
+//
+// Particles are binned into RASTER_TILE_SIZE tiles, each thread binning its
+// own slice of the particles; tiles are then filled in parallel, taking the
+// slices in order so overlapping circles are drawn in particle order like
+// the GL path. Rows are bottom-up as glReadPixels returns them, so frames go
+// straight to VideoWriter or into a texture.
+class SoftwareRasterizer {
+private:
+    int width = 0;
+    int height = 0;
+    int tilesX = 0;
+    int tilesY = 0;
+    std::vector<uint32_t> pixels;             // RGBA8 in memory order
+    std::vector<std::vector<int>> bins;       // [thread * tiles + tile] particle indices
+    int binThreads = 0;
+    uint32_t clearColor = 0;
+    const uint32_t* background = nullptr;     // Image under the particles, null for clearColor
+
+    // Pixels whose centers lie in [center - r, center + r] on one axis
+    static void pixelSpan(float center, float r, int size, int& first, int& last) {
+        float scale = size * 0.5f;
+        first = std::max(0, static_cast<int>(std::ceil((center - r + 1.0f) * scale - 0.5f)));
+        last = std::min(size - 1, static_cast<int>(std::floor((center + r + 1.0f) * scale - 0.5f)));
+    }
+
+    void binParticles(ThreadPool& pool, const float* positions, const float* radiusColor, int count) {
+        int tiles = tilesX * tilesY;
+        binThreads = pool.getThreadCount();
+        if (static_cast<int>(bins.size()) != binThreads * tiles) bins.assign(binThreads * tiles, std::vector<int>());
+
+        pool.forEachThread([&](int thread) {
+            std::vector<int>* threadBins = &bins[thread * tiles];
+            for (int tile = 0; tile < tiles; tile++) threadBins[tile].clear();
+
+            int begin, end;
+            stableRange(thread, binThreads, count, count, begin, end);
+            for (int i = begin; i < end; i++) {
+                float r = radiusColor[i * 4];
+                int x0, x1, y0, y1;
+                pixelSpan(positions[i * 2], r, width, x0, x1);
+                pixelSpan(positions[i * 2 + 1], r, height, y0, y1);
+                if (x0 > x1 || y0 > y1) continue;
+
+                for (int ty = y0 / RASTER_TILE_SIZE; ty <= y1 / RASTER_TILE_SIZE; ty++) {
+                    for (int tx = x0 / RASTER_TILE_SIZE; tx <= x1 / RASTER_TILE_SIZE; tx++) {
+                        threadBins[ty * tilesX + tx].push_back(i);
+                    }
+                }
+            }
+        });
+    }
+
+    // Covers the pixels x0..x1 of a row whose centers are within r of (cx, cy);
+    // dy2 is the row's squared distance to cy
+    void coverRow(uint32_t* row, int x0, int x1, float cx, float dy2, float r2, uint32_t color) const {
+        float pixelWidth = 2.0f / width;
+        int x = x0;
+#if defined(__SSE2__)
+        const __m128 lanes = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 step = _mm_set1_ps(pixelWidth);
+        const __m128 center = _mm_set1_ps(cx + 1.0f);
+        const __m128 rowDistance = _mm_set1_ps(dy2);
+        const __m128 limit = _mm_set1_ps(r2);
+        const __m128i fill = _mm_set1_epi32(static_cast<int>(color));
+        for (; x + 3 <= x1; x += 4) {
+            __m128 dx = _mm_sub_ps(_mm_mul_ps(_mm_add_ps(_mm_set1_ps(static_cast<float>(x)), lanes), step), center);
+            __m128 distance = _mm_add_ps(_mm_mul_ps(dx, dx), rowDistance);
+            __m128i inside = _mm_castps_si128(_mm_cmple_ps(distance, limit));
+            __m128i* target = reinterpret_cast<__m128i*>(row + x);
+            __m128i old = _mm_loadu_si128(target);
+            _mm_storeu_si128(target, _mm_or_si128(_mm_and_si128(inside, fill), _mm_andnot_si128(inside, old)));
+        }
+#endif
+        for (; x <= x1; x++) {
+            float dx = (x + 0.5f) * pixelWidth - (cx + 1.0f);
+            if (dx * dx + dy2 <= r2) row[x] = color;
+        }
+    }
+
+    void rasterizeTile(int tile, const float* positions, const float* radiusColor) {
+        int tileX0 = (tile % tilesX) * RASTER_TILE_SIZE;
+        int tileY0 = (tile / tilesX) * RASTER_TILE_SIZE;
+        int tileX1 = std::min(width, tileX0 + RASTER_TILE_SIZE) - 1;
+        int tileY1 = std::min(height, tileY0 + RASTER_TILE_SIZE) - 1;
+        float pixelHeight = 2.0f / height;
+
+        for (int y = tileY0; y <= tileY1; y++) {
+            if (background) {
+                std::copy(&background[y * width + tileX0], &background[y * width + tileX1] + 1, &pixels[y * width + tileX0]);
+            } else {
+                std::fill(&pixels[y * width + tileX0], &pixels[y * width + tileX1] + 1, clearColor);
+            }
+        }
+
+        int tiles = tilesX * tilesY;
+        for (int thread = 0; thread < binThreads; thread++) {
+            for (int i : bins[thread * tiles + tile]) {
+                float cx = positions[i * 2];
+                float cy = positions[i * 2 + 1];
+                const float* particle = &radiusColor[i * 4];
+                float r = particle[0];
+                uint32_t color = packRgba8(particle[1], particle[2], particle[3]);
+
+                int x0, x1, y0, y1;
+                pixelSpan(cx, r, width, x0, x1);
+                pixelSpan(cy, r, height, y0, y1);
+                x0 = std::max(x0, tileX0);
+                x1 = std::min(x1, tileX1);
+                y0 = std::max(y0, tileY0);
+                y1 = std::min(y1, tileY1);
+
+                for (int y = y0; y <= y1; y++) {
+                    float dy = (y + 0.5f) * pixelHeight - 1.0f - cy;
+                    coverRow(&pixels[y * width], x0, x1, cx, dy * dy, r * r, color);
+                }
+            }
+        }
+    }
+
+public:
+    SoftwareRasterizer() { setClearColor(0.1f, 0.1f, 0.1f); }
+
+    void resize(int width, int height) {
+        if (width == this->width && height == this->height) return;
+        this->width = width;
+        this->height = height;
+        tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+        pixels.assign(static_cast<size_t>(width) * height, clearColor);
+        bins.clear();
+    }
+
+    void setClearColor(float r, float g, float b) { clearColor = packRgba8(r, g, b); }
+
+    // RGBA8 image of the current size drawn under the particles (collider
+    // geometry), kept by the caller; null goes back to the clear color
+    void setBackground(const uint32_t* image) { background = image; }
+
+    // positions: x, y per particle; radiusColor: radius, r, g, b per particle
+    // (the layout of the GL instance buffers)
+    void render(ThreadPool& pool, const float* positions, const float* radiusColor, int count) {
+        {
+            PROFILE_SCOPE(g_profiler, "Raster Binning");
+            binParticles(pool, positions, radiusColor, count);
+        }
+        PROFILE_SCOPE(g_profiler, "Raster Tiles");
+        pool.parallelFor(tilesX * tilesY, [&](int tile, int) {
+            rasterizeTile(tile, positions, radiusColor);
+        });
+    }
+
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+    const uint8_t* data() const { return reinterpret_cast<const uint8_t*>(pixels.data()); }
+};
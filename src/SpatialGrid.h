@@ -1,4 +1,5 @@
 #pragma once
+#include "HugePageArena.h"
 #include <vector>
 #include <algorithm>
 #include <cmath>
@@ -8,7 +9,7 @@ private:
     float cellSize;
     int gridWidth, gridHeight;
     float worldMinX, worldMinY, worldMaxX, worldMaxY;
-    std::vector<std::vector<int>> grid;
+    ArenaVector<ArenaVector<int>> grid;
     
 public:
     SpatialGrid(float cellSize, float minX, float minY, float maxX, float maxY) 
@@ -25,20 +26,36 @@ public:
         }
     }
     
+    // Cell coordinates of a point, clamped to grid bounds
+    int getCellX(float x) const {
+        return std::max(0, std::min(static_cast<int>((x - worldMinX) / cellSize), gridWidth - 1));
+    }
+    
+    int getCellY(float y) const {
+        return std::max(0, std::min(static_cast<int>((y - worldMinY) / cellSize), gridHeight - 1));
+    }
+    
+    int getCellIndex(float x, float y) const {
+        return getCellY(y) * gridWidth + getCellX(x);
+    }
+    
+    const ArenaVector<int>& getCell(int cellIndex) const { return grid[cellIndex]; }
+    
+    int getWidth() const { return gridWidth; }
+    int getHeight() const { return gridHeight; }
+    float getCellSize() const { return cellSize; }
+    float getMinX() const { return worldMinX; }
+    float getMinY() const { return worldMinY; }
+    float getMaxX() const { return worldMaxX; }
+    float getMaxY() const { return worldMaxY; }
+    
     void addParticle(int particleIndex, float x, float y) {
-        int gridX = static_cast<int>((x - worldMinX) / cellSize);
-        int gridY = static_cast<int>((y - worldMinY) / cellSize);
-        
-        // Clamp to grid bounds
-        gridX = std::max(0, std::min(gridX, gridWidth - 1));
-        gridY = std::max(0, std::min(gridY, gridHeight - 1));
-        
-        int cellIndex = gridY * gridWidth + gridX;
-        grid[cellIndex].push_back(particleIndex);
+        grid[getCellIndex(x, y)].push_back(particleIndex);
     }
     
-    std::vector<int> getNearbyParticles(float x, float y, float radius) {
-        std::vector<int> nearby;
+    // Fills nearby in place so the caller's buffer keeps its capacity
+    void getNearbyParticles(float x, float y, float radius, ArenaVector<int>& nearby) {
+        nearby.clear();
         
         // Calculate grid cell range to check
         int minGridX = static_cast<int>((x - radius - worldMinX) / cellSize);
@@ -61,7 +78,5 @@ public:
                 }
             }
         }
-        
-        return nearby;
     }
 };
@@ -0,0 +1,25 @@
+#pragma once
+#include "HugePageArena.h"
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+// FNV-1a over the raw bits of the particle state. Two runs with equal
+// checksums on every frame are bitwise identical simulations.
+template <typename Position>
+uint64_t stateChecksum(const ArenaVector<Position>& positions, const ArenaVector<Position>& lastPositions, int count) {
+    static_assert(sizeof(Position) == 4, "positions are hashed as 32-bit words");
+    uint64_t hash = 14695981039346656037ULL;
+    const ArenaVector<Position>* arrays[] = { &positions, &lastPositions };
+    for (const ArenaVector<Position>* values : arrays) {
+        for (int i = 0; i < count * 2; i++) {
+            uint32_t bits;
+            std::memcpy(&bits, &(*values)[i], sizeof(bits));
+            for (int byte = 0; byte < 4; byte++) {
+                hash ^= (bits >> (byte * 8)) & 0xFFu;
+                hash *= 1099511628211ULL;
+            }
+        }
+    }
+    return hash;
+}
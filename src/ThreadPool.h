@@ -0,0 +1,156 @@
+#pragma once
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <vector>
+#include <algorithm>
+#include "NumaPlacement.h"
+
+// New threads inherit the creator's policy, so a pool created from the
+// SCHED_FIFO render thread (--realtime) would spin its workers at real-time
+// priority; they go back to the default time-sharing policy instead
+inline void useTimeSharingScheduling() {
+#ifdef __linux__
+    int policy;
+    sched_param param;
+    if (pthread_getschedparam(pthread_self(), &policy, &param) != 0 || policy == SCHED_OTHER) return;
+    param.sched_priority = 0;
+    pthread_setschedparam(pthread_self(), SCHED_OTHER, &param);
+#endif
+}
+
+// Persistent worker threads for the parallel physics phases.
+// The calling thread takes part in every parallelFor, so a pool of N threads
+// only spawns N - 1 workers. With pinning, thread i runs on the i-th CPU in
+// node order (see NumaPlacement.h), the calling thread being thread 0.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable startCondition;
+    std::condition_variable doneCondition;
+
+    std::function<void(int, int)> task;
+    int taskCount = 0;
+    bool taskPerThread = false; // forEachThread: task index == thread index
+    std::atomic<int> nextTask;
+    std::vector<int> threadCpus; // Pinned CPU per thread, empty when not pinned
+    int busyWorkers = 0;
+    unsigned generation = 0;
+    bool stopping = false;
+
+    void runTasks(int threadIndex) {
+        if (taskPerThread) {
+            task(threadIndex, threadIndex);
+            return;
+        }
+        int index;
+        while ((index = nextTask.fetch_add(1)) < taskCount) {
+            task(index, threadIndex);
+        }
+    }
+
+    void workerLoop(int threadIndex) {
+        if (!threadCpus.empty()) pinCurrentThread(threadCpus[threadIndex]);
+        useTimeSharingScheduling();
+        unsigned seenGeneration = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                startCondition.wait(lock, [&] { return stopping || generation != seenGeneration; });
+                if (stopping) return;
+                seenGeneration = generation;
+            }
+
+            runTasks(threadIndex);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busyWorkers == 0) {
+                doneCondition.notify_one();
+            }
+        }
+    }
+
+public:
+    // threadCount <= 0 uses every hardware thread
+    explicit ThreadPool(int threadCount, bool pinThreads = false) : nextTask(0) {
+        if (threadCount <= 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        if (pinThreads) {
+            std::vector<int> cpus = NumaTopology().cpuOrder();
+            for (int i = 0; i < threadCount; i++) {
+                threadCpus.push_back(cpus[i % cpus.size()]);
+            }
+            pinCurrentThread(threadCpus[0]);
+        }
+        for (int i = 1; i < threadCount; i++) {
+            workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        startCondition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    int getThreadCount() const {
+        return static_cast<int>(workers.size()) + 1;
+    }
+
+    // CPU of a pinned thread, -1 when the pool is not pinned
+    int getThreadCpu(int threadIndex) const {
+        return threadCpus.empty() ? -1 : threadCpus[threadIndex];
+    }
+
+    // Runs body(index, threadIndex) for every index in [0, count) and waits for
+    // all of them. Indices are handed out dynamically, so callers must not rely
+    // on which thread runs which index.
+    void parallelFor(int count, const std::function<void(int, int)>& body) {
+        if (workers.empty() || count <= 1) {
+            for (int i = 0; i < count; i++) {
+                body(i, 0);
+            }
+            return;
+        }
+        run(count, false, body);
+    }
+
+    // Runs body(threadIndex) exactly once on every thread of the pool. Unlike
+    // parallelFor the assignment is fixed, so work split by thread index
+    // touches the same memory from the same core on every call.
+    void forEachThread(const std::function<void(int)>& body) {
+        if (workers.empty()) {
+            body(0);
+            return;
+        }
+        run(getThreadCount(), true, [&](int, int thread) { body(thread); });
+    }
+
+private:
+    void run(int count, bool perThread, const std::function<void(int, int)>& body) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            task = body;
+            taskCount = count;
+            taskPerThread = perThread;
+            nextTask = 0;
+            busyWorkers = static_cast<int>(workers.size());
+            generation++;
+        }
+        startCondition.notify_all();
+
+        runTasks(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        doneCondition.wait(lock, [&] { return busyWorkers == 0; });
+    }
+};
@@ -1,7 +1,22 @@
 #include "glad/glad.h"
 #include "GLFW/glfw3.h"
-#include "SpatialGrid.h"
+#include "Simulation.h"
+#include "PipelineSwitcher.h"
+#include "SignedDistanceField.h"
+#include "InputLog.h"
 #include "PerformanceProfiler.h"
+#include "FramePacer.h"
+#include "QualityGovernor.h"
+#include "InputLatency.h"
+#include "GpuTimer.h"
+#include "OffscreenContext.h"
+#include "FrameCapture.h"
+#include "SoftwareRasterizer.h"
+#include "DensityRenderer.h"
+#include "ShaderCache.h"
+#include "Hud.h"
+#include "GridAnalytics.h"
+#include "CommandSources.h"
 #include <stdio.h>
 #include <vector>
 #include <iostream>
@@ -9,51 +24,134 @@
 #include <random>
 #include <numeric>
 #include <chrono>
-#include <unistd.h>
+#include <string>
+#include <cstring>
+#include <cstdlib>
+#include <memory>
+
+// Command line options (see printUsage)
+struct RunOptions {
+    std::string recordPath;
+    std::string replayPath;
+    uint32_t seed = 0;
+    bool seedSet = false;
+    int threads = WORKER_THREADS;
+    bool threadsSet = false;
+    std::string layout = DEFAULT_LAYOUT;
+    std::string integrator = DEFAULT_INTEGRATOR;
+    bool pipelineSet = false;
+    PageMode pageMode = ARENA_PAGE_MODE;
+    bool pinThreads = PIN_THREADS;
+    bool realtime = REALTIME_SCHEDULING;
+    bool governor = QUALITY_GOVERNOR;
+    std::string videoPath; // Replay frames rendered offscreen to a video stream
+    std::string renderer = DEFAULT_RENDERER;
+    bool shaderCache = true;
+    std::string scene = DEFAULT_SCENE; // Collider scene name or file
+    bool sceneSet = false;
+    std::string field = DEFAULT_FORCE_FIELD; // Force field name or file
+    bool fieldSet = false;
+    std::vector<PipelineSpec> abPipelines; // --ab, alternated every abFrames frames
+    int abFrames = AB_SWITCH_FRAMES;
+    bool events = false; // Collision event stream, written to eventsPath when set
+    std::string eventsPath;
+    float eventImpulse = COLLISION_EVENT_IMPULSE;
+    int analyticsInterval = 0; // Frames between analytics passes, 0 = off; written to analyticsPath when set
+    std::string analyticsPath;
+    std::string controlPath; // Control socket for command lines
+    std::string configPath;  // Config file of commands, applied again whenever it changes
+};
+
+// Index range of one circle tessellation in the shared element buffer
+struct CircleLod {
+    int firstIndex;
+    int indexCount;
+};
+
+// Texture holding a frame drawn on the CPU, blitted to the window
+struct SoftwareFrame {
+    unsigned int texture = 0, framebuffer = 0;
+    int width = 0, height = 0;
+};
+
+// GL objects for drawing the particles, shared by the window and offscreen video
+struct ParticleRenderer {
+    unsigned int VAO = 0, positionVBO = 0, lastPositionVBO = 0, radiusColorVBO = 0, shaderProgram = 0;
+    int speedScaleLocation = -1;
+    std::vector<float> radiusColorData;
+    std::vector<unsigned int> indices;
+    std::vector<CircleLod> circleLods;
+    SoftwareFrame background; // Collider geometry, blitted instead of clearing when present
+};
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
-void processInput(GLFWwindow *window, std::vector<float>& acceleration);
-void generatePositionsAndStaticData(std::vector<float>&, std::vector<float>&, std::vector<float>&, std::vector<float>& );
-void genAndBindBuffers(unsigned int&, unsigned int&, unsigned int&, std::vector<float>&, std::vector<float>&, std::vector<unsigned int>&, std::vector<float>&);
+void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+FrameInput processInput(GLFWwindow *window, SimulationBase& simulation, Hud& hud, PipelineSpec& pipeline);
+void appendStaticData(std::vector<float>& radiusColorData, int particleCount);
+void createParticleRenderer(ParticleRenderer& renderer, ShaderCache& shaderCache);
+void addSpawnedParticles(ParticleRenderer& renderer, int particleCount);
+void drawParticles(ParticleRenderer& renderer, GpuTimer& gpuTimer, const float* positions, const float* lastPositions,
+                   int particleCount, int lod, float stepTime);
+void presentSoftwareFrame(SoftwareFrame& frame, const uint8_t* pixels, int width, int height, GpuTimer& gpuTimer);
+void uploadSoftwareFrame(SoftwareFrame& frame, const uint8_t* pixels, int width, int height);
+void blitSoftwareFrame(const SoftwareFrame& frame);
+void uploadSoftwareFrameRect(SoftwareFrame& frame, const uint32_t* pixels, const PixelRect& rect);
+bool bakeColliders(const std::string& sceneName, SignedDistanceField& colliders, std::vector<KinematicCollider>& kinematic);
+void paintColliders(const SignedDistanceField& colliders, int width, int height, std::vector<uint32_t>& pixels);
+bool loadForceField(const std::string& fieldName, ForceField& field);
+std::unique_ptr<CollisionEventStream> startCollisionEvents(const RunOptions& options, const PipelineSpec& startPipeline);
+bool openAnalytics(const RunOptions& options, std::shared_ptr<FILE>& file);
+void updateAnalytics(GridAnalytics& analytics, SimulationBase& simulation, int interval, FILE* file);
+bool startCommandSources(const RunOptions& options, CommandQueue& queue, std::unique_ptr<ConfigWatcher>& watcher,
+                         std::unique_ptr<ControlSocket>& socket);
+void applyCommands(CommandQueue& queue, SimulationBase& simulation, int layoutHeight, std::vector<std::string>& applied);
+const std::vector<PixelRect>& paintKinematicColliders(KinematicLayer& layer, const KinematicColliders& kinematic,
+                                                      const std::vector<uint32_t>& background);
+void genAndBindBuffers(unsigned int&, unsigned int&, unsigned int&, unsigned int&, std::vector<float>&, std::vector<float>&, std::vector<unsigned int>&, std::vector<float>&);
 int initWindow(GLFWwindow *window);
-void creatingCircles(std::vector<float>&, std::vector<unsigned int>&);
+void creatingCircles(std::vector<float>&, std::vector<unsigned int>&, std::vector<CircleLod>&);
 int creatingVertexShader(unsigned int);
 int creatingFragmentShader(unsigned int);
 int creatingShaderProgram(unsigned int, unsigned int, unsigned int);
+bool parseArguments(int argc, char** argv, RunOptions& options);
+void printUsage(const char* program);
+int runReplay(const RunOptions& options, std::chrono::steady_clock::time_point startupBegin);
+int inputKeys(const FrameInput& input);
+FrameInput frameInputFromKeys(int keys);
+void printStartupStats(const ShaderCache& shaderCache, std::chrono::steady_clock::time_point startupBegin);
+std::vector<HudSegment> hudSegments(SimulationBase& simulation);
+std::vector<std::string> hudLines(SimulationBase& simulation, const Hud& hud, int collisionChecks, int collisionContacts);
 
 
 
 int SRC_HEIGHT = 720;
 int SRC_WIDTH = 720;
-const int NUMCIRCLES = 3800; // Number of circles to simulate
-const float radius = 0.008f;
-
-// Circle spawning settings
-const float SPAWN_INTERVAL_MS = 10.0f;
-const int NUMBER_OF_CIRCLES_SPAWNED = 10;
-const int segments = 32;
-const float precision = radius * radius * 0.1f; // Precision for distance calculations
 
-// Frame rate limiting variables
-const float TARGET_FPS = 60.0f;
-const float UPDATER_PER_FRAME = 8.0f;
-const float deltaTime = (1.0f / TARGET_FPS) / UPDATER_PER_FRAME; 
+// Startup phases in order, each timed once into the profiler
+const char* const STARTUP_PHASES[] = {
+    "Startup: Arena", "Startup: GLFW Init", "Startup: Window", "Startup: GL Context", "Startup: GLAD Load",
+    "Startup: Simulation", "Startup: Colliders", "Startup: Force Field", "Startup: Buffers", "Startup: Shader Cache Load", "Startup: Shader Compile"
+};
 
-//spawning velocity
-const float velocityX = 3.1f; // X velocity for spawning circles
-const float velocityY = 1.0f; // Y velocity for spawning circles
+// Frames between profiler reports in headless replay (5 s of simulated time, like the window)
+const int REPLAY_STATS_INTERVAL = static_cast<int>(TARGET_FPS) * 5;
 
 const char *vertexShaderSource = "#version 330 core\n"
     "layout (location = 0) in vec3 aPos;\n"
     "layout (location = 1) in vec2 instancePos;\n"
     "layout (location = 2) in float instanceRadius;\n"
     "layout (location = 3) in vec3 instanceColor;\n"
+    "layout (location = 4) in vec2 instanceLastPos;\n"
+    "uniform float speedScale;\n" // 1 / (step time * SPEED_COLOR_MAX), 0 = plain instance color
     "out vec3 fragColor;\n"
     "void main()\n"
     "{\n"
     "   vec3 worldPos = aPos * instanceRadius + vec3(instancePos, 0.0);\n"
     "   gl_Position = vec4(worldPos, 1.0);\n"
-    "   fragColor = instanceColor;\n"
+    "   float t = clamp(length(instancePos - instanceLastPos) * speedScale, 0.0, 1.0);\n"
+    "   vec3 slow = vec3(0.2, 0.4, 1.0), medium = vec3(0.2, 1.0, 0.4), fast = vec3(1.0, 0.25, 0.1);\n"
+    "   vec3 speedColor = t < 0.5 ? mix(slow, medium, t * 2.0) : mix(medium, fast, t * 2.0 - 1.0);\n"
+    "   fragColor = speedScale > 0.0 ? instanceColor * speedColor : instanceColor;\n"
     "}\0";
 
 const char *fragmentShaderSource = "#version 330 core\n"
@@ -65,10 +163,35 @@ const char *fragmentShaderSource = "#version 330 core\n"
     "}\0";
 
 
-int main(void) {
-    
-    if (!glfwInit())
+int main(int argc, char** argv) {
+
+    auto startupBegin = std::chrono::steady_clock::now();
+    RunOptions options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
         return -1;
+    }
+    if (options.videoPath == "-") VideoWriter::reserveStdout();
+
+    // Storage for every particle and grid array, reserved before the first one is created
+    {
+        PROFILE_SCOPE(g_profiler, "Startup: Arena");
+        if (!particleArena().reserve(ARENA_BYTES, options.pageMode)) {
+            std::cout << "Failed to reserve " << (ARENA_BYTES >> 20) << " MB for particle storage" << std::endl;
+            return -1;
+        }
+    }
+
+    // Replays run the recorded frames without a window
+    if (!options.replayPath.empty()) {
+        return runReplay(options, startupBegin);
+    }
+
+    {
+        PROFILE_SCOPE(g_profiler, "Startup: GLFW Init");
+        if (!glfwInit())
+            return -1;
+    }
 
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
@@ -77,57 +200,113 @@ int main(void) {
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
     #endif
     
-    GLFWwindow* window = glfwCreateWindow(SRC_WIDTH, SRC_HEIGHT, "FPS: -", NULL, NULL);
+    GLFWwindow* window;
+    {
+        PROFILE_SCOPE(g_profiler, "Startup: Window");
+        window = glfwCreateWindow(SRC_WIDTH, SRC_HEIGHT, "FPS: -", NULL, NULL);
+    }
     initWindow(window);
-    
-    std::vector<float> circleVertices, positions, lastPositions, radiusColorData;
-    std::vector<float> acceleration;
-
-    unsigned int VAO, positionVBO, radiusColorVBO, vertexShader, fragmentShader, shaderProgram;
 
-    positions.clear();
-    radiusColorData.clear();
-    std::vector<unsigned int> indices;
-    
-    // generating circle by composing them of smaller triangles
-    creatingCircles(circleVertices, indices);
-
-    // generate position of first circle and static data for instances
-    generatePositionsAndStaticData(lastPositions, positions, radiusColorData, acceleration);
-
-    genAndBindBuffers(VAO, positionVBO, radiusColorVBO, positions, radiusColorData, indices, circleVertices);
-
-    vertexShader = creatingVertexShader(vertexShader);
-
-    fragmentShader = creatingFragmentShader(fragmentShader);
-
-    shaderProgram = creatingShaderProgram(shaderProgram, fragmentShader, vertexShader);
-
-    // delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    uint32_t seed = options.seedSet ? options.seed : std::random_device()();
+    PipelineSpec startPipeline;
+    startPipeline.layout = options.layout;
+    startPipeline.integrator = options.integrator;
+    startPipeline.threads = options.threads;
+    if (!options.abPipelines.empty()) startPipeline = options.abPipelines[0];
+
+    // Every pipeline the scene runs on, switched between frames with L, I and T or by --ab
+    PipelineSwitcher pipelines(options.pinThreads, seed);
+    pipelines.retain(options.abPipelines);
+    SimulationBase* firstPipeline;
+    {
+        PROFILE_SCOPE(g_profiler, "Startup: Simulation");
+        firstPipeline = pipelines.start(startPipeline, COLLISION_MODE);
+    }
+    if (!firstPipeline) {
+        std::cout << "Unknown pipeline " << startPipeline.layout << "/" << startPipeline.integrator
+                  << ", available: " << availableSimulations() << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    std::cout << "Pipeline: " << firstPipeline->getLayoutName() << "/" << firstPipeline->getIntegratorName() << std::endl;
+    firstPipeline->printPlacement();
 
-    // Unbind VAO
-    glBindVertexArray(0);
+    // Collider geometry, shared by every pipeline the scene moves to
+    SignedDistanceField colliders;
+    std::vector<KinematicCollider> kinematic;
+    if (!bakeColliders(options.scene, colliders, kinematic)) {
+        glfwTerminate();
+        return -1;
+    }
+    firstPipeline->setColliders(&colliders);
+    firstPipeline->setKinematicColliders(kinematic);
+    ForceField forceField;
+    if (!loadForceField(options.field, forceField)) {
+        glfwTerminate();
+        return -1;
+    }
+    firstPipeline->setForceField(&forceField);
+    std::unique_ptr<CollisionEventStream> collisionEvents;
+    if (options.events) {
+        collisionEvents = startCollisionEvents(options, startPipeline);
+        if (!collisionEvents) {
+            glfwTerminate();
+            return -1;
+        }
+        firstPipeline->setCollisionEvents(collisionEvents.get());
+    }
+    GridAnalytics analytics(ANALYTICS_CELLS_PER_BIN, ANALYTICS_CONTACT_DISTANCE);
+    std::shared_ptr<FILE> analyticsFile;
+    if (!openAnalytics(options, analyticsFile)) {
+        glfwTerminate();
+        return -1;
+    }
+    // Parameter changes, spawns and removals from other threads, applied at the start of each frame
+    CommandQueue commands(COMMAND_QUEUE_SIZE);
+    std::unique_ptr<ConfigWatcher> configWatcher;
+    std::unique_ptr<ControlSocket> controlSocket;
+    if (!startCommandSources(options, commands, configWatcher, controlSocket)) {
+        glfwTerminate();
+        return -1;
+    }
 
+    // Only the render thread runs SCHED_FIFO: worker pools, including the ones
+    // PipelineSwitcher creates later from this thread, reset theirs (ThreadPool.h)
+    if (options.realtime) enableRealtimeScheduling(REALTIME_PRIORITY);
+
+    InputRecorder recorder;
+    if (!options.recordPath.empty()) {
+        InputLogHeader header;
+        header.seed = seed;
+        header.threads = firstPipeline->getThreadCount();
+        header.layout = firstPipeline->getLayoutName();
+        header.integrator = firstPipeline->getIntegratorName();
+        header.scene = options.scene;
+        header.field = options.field;
+        if (!recorder.open(options.recordPath, header)) {
+            std::cout << "Failed to open input log for recording: " << options.recordPath << std::endl;
+            glfwTerminate();
+            return -1;
+        }
+        std::cout << "Recording input to " << options.recordPath << " (seed " << seed << ")" << std::endl;
+    }
     
-    // // Pre-calculate constants for optimization
-    const float radiusSum = 2.0f * radius;
-    const float radiusSumSquared = radiusSum * radiusSum;
-    const float wallLeft = -1.0f + radius;
-    const float wallRight = 1.0f - radius;
-    const float wallBottom = -1.0f + radius;
-    const float wallTop = 1.0f - radius;
-    const float damping = 0.55f;
-
-    // distance calculation variables
-    float dx, dy, distanceSquared, distance, invDistance, nx, ny, overlap;
-
-    // spawning circles
-    int remainingCirclesToSpawn = NUMCIRCLES - NUMBER_OF_CIRCLES_SPAWNED;
-
-    const float GRID_CELL_SIZE = radius * 2.2f; // Optimal cell size
-    SpatialGrid spatialGrid(GRID_CELL_SIZE, -1.0f, -1.0f, 1.0f, 1.0f);
+    // Warm starts load the linked program instead of compiling the shaders
+    ShaderCache shaderCache(options.shaderCache ? SHADER_CACHE_FILE : "", vertexShaderSource, fragmentShaderSource);
+    ParticleRenderer renderer;
+    createParticleRenderer(renderer, shaderCache);
+
+    // CPU rasterizer or density heatmap on the simulation's thread pool instead of the instanced draw
+    SoftwareRasterizer rasterizer;
+    DensityRenderer density;
+    SoftwareFrame softwareFrame;
+    if (options.renderer != "gl") std::cout << "Renderer: " << options.renderer << std::endl;
+
+    // Collider geometry under the particles, painted again when the window size
+    // changes; the moving colliders are drawn over it every frame
+    std::vector<uint32_t> background;
+    KinematicLayer colliderLayer;
+    int backgroundWidth = 0, backgroundHeight = 0;
 
     // FPS check
     int frames = 1;
@@ -139,38 +318,65 @@ int main(void) {
     auto fpsTimer = frameStartTime;  // Separate timer for FPS counter
     float actualDeltaTime = 0.0f;
 
-    float separation, x, y;
-    int activeParticles;
-    std::vector<int> nearby;
-
     g_profiler.collisionCheck = 0;
     g_profiler.collisionVerified = 0;
 
+    FramePacer pacer(TARGET_FPS, std::chrono::microseconds(FRAME_SPIN_MARGIN_US));
+    QualityGovernor governor(FRAME_BUDGET_MS);
+
+    // Key presses are timestamped by key_callback
+    InputLatencyTracker latency;
+    glfwSetWindowUserPointer(window, &latency);
+    glfwSetKeyCallback(window, key_callback);
+
+    // GPU execution time of the render scopes, read back a few frames later
+    GpuTimer gpuTimer(g_profiler);
+    if (!gpuTimer.isSupported()) std::cout << "GPU timer queries unavailable" << std::endl;
+
+    // Overlay toggled with H, drawn over either renderer
+    Hud hud;
+    int countedChecks = 0, countedContacts = 0;
+
+    printStartupStats(shaderCache, startupBegin);
+
+    // Frame timings from here on are kept per pipeline
+    g_profiler.setBackend(pipelineLabel(*firstPipeline));
+    PipelineSpec nextPipeline = pipelines.currentSpec();
+    size_t abIndex = 0;
+    int abFrames = 0;
 
     // render loop
     while (!glfwWindowShouldClose(window)) {
+        // Pipeline switches happen between frames, on the state the last one left
+        if (!samePipeline(nextPipeline, pipelines.currentSpec())) {
+            if (pipelines.switchTo(nextPipeline)) {
+                g_profiler.setBackend(pipelineLabel(pipelines.current()));
+                governor.settle();
+            }
+            nextPipeline = pipelines.currentSpec();
+        }
+        SimulationBase& simulation = pipelines.current();
+
         // Calculate delta time
         frameStartTime = std::chrono::steady_clock::now();
         deltaTimeDuration = frameStartTime - lastTime;
         lastTime = frameStartTime;
         actualDeltaTime = deltaTimeDuration.count();
 
+        InputLogEntry logEntry;
+        logEntry.frame = simulation.getFrame();
 
-        // spawn a circle (if they are not over) every SPAWN_INTERVAL_MS milliseconds
+        // Queued commands first, at the same point of every frame, so the log replays them there
+        applyCommands(commands, simulation, SRC_HEIGHT, logEntry.commands);
+
+        // spawn a circle (if they are not over) every spawn interval
         // Using fixed timestep for consistent spawning regardless of FPS
-        static int framesSinceLastSpawn = 0;
-        const int framesPerSpawn = static_cast<int>((SPAWN_INTERVAL_MS / 1000.0f) * TARGET_FPS); // Convert ms to frames
-        
-        if(remainingCirclesToSpawn > 0 && framesSinceLastSpawn >= framesPerSpawn){
-            generatePositionsAndStaticData(lastPositions, positions, radiusColorData, acceleration);
-            remainingCirclesToSpawn -= NUMBER_OF_CIRCLES_SPAWNED;
-            framesSinceLastSpawn = 0; // Reset frame counter
-            
-            // Update radius/color buffer with new data
-            glBindBuffer(GL_ARRAY_BUFFER, radiusColorVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, radiusColorData.size() * sizeof(float), radiusColorData.data());
-        }
-        framesSinceLastSpawn++;
+        if(simulation.spawnDue()){
+            simulation.spawn(simulation.getSpawnCount(), SRC_HEIGHT);
+            logEntry.spawnCount = simulation.getSpawnCount();
+            logEntry.spawnLayoutHeight = SRC_HEIGHT;
+        }
+        if (logEntry.spawnCount > 0 || !logEntry.commands.empty()) addSpawnedParticles(renderer, simulation.getParticleCount());
 
         // reset the timer for the frame counter
         if(reset){
@@ -178,141 +384,115 @@ int main(void) {
             reset = false;
         }
 
-        for (int physicsStep = 0; physicsStep < UPDATER_PER_FRAME; physicsStep++) {
-            // Update positions based on Verlet integration
-            {
-                PROFILE_SCOPE(g_profiler, "Verlet Integration");
-                for (int i = 0; i < NUMCIRCLES - remainingCirclesToSpawn; i++){
-                    // Store current position as next frame's lastPosition
-                    float tempX = positions[i * 2];
-                    float tempY = positions[i * 2 + 1];
-                    
-                    // Verlet integration: x(n+1) = 2*x(n) - x(n-1) + a*dt^2
-                    positions[i * 2] = 2.0f * positions[i * 2] - lastPositions[i * 2] + acceleration[i * 2] * deltaTime * deltaTime;
-                    positions[i * 2 + 1] = 2.0f * positions[i * 2 + 1] - lastPositions[i * 2 + 1] + acceleration[i * 2 + 1] * deltaTime * deltaTime;
-                    
-                    // Update lastPositions for next frame
-                    lastPositions[i * 2] = tempX;
-                    lastPositions[i * 2 + 1] = tempY;
-                    
-                }
-            }
-            
-            // Wall collisions (after position update)
-            {
-                PROFILE_SCOPE(g_profiler, "Wall Collisions");
-                for (int i = 0; i < NUMCIRCLES - remainingCirclesToSpawn; i++) {
-                    // Bounce off left and right walls
-                    if(positions[i * 2] <= wallLeft) {
-                        // For Verlet integration, reverse velocity by reflecting lastPosition
-                        lastPositions[i * 2] = wallLeft + (positions[i * 2] - lastPositions[i * 2]) * damping;
-                        positions[i * 2] = wallLeft;
-                    }
-                    else if(positions[i * 2] >= wallRight) {
-                        // Reverse velocity: subtract the velocity difference instead of adding
-                        lastPositions[i * 2] = wallRight + (positions[i * 2] - lastPositions[i * 2]) * damping;
-                        positions[i * 2] = wallRight;
-                    }
-                    
-                    // Bounce off top and bottom walls
-                    if(positions[i * 2 + 1] <= wallBottom) {
-                        lastPositions[i * 2 + 1] = wallBottom + (positions[i * 2 + 1] - lastPositions[i * 2 + 1]) * damping;
-                        positions[i * 2 + 1] = wallBottom;
-                        
-                    }else if(positions[i * 2 + 1] >= wallTop) {
-                        lastPositions[i * 2 + 1] = wallTop + (positions[i * 2 + 1] - lastPositions[i * 2 + 1]) * damping;
-                        positions[i * 2 + 1] = wallTop;
-                    }
-                }
-            }
-
-            //Collision between objects using spatial grid optimization
-            {
-                PROFILE_SCOPE(g_profiler, "Particle Collisions");
-                activeParticles = NUMCIRCLES - remainingCirclesToSpawn;
-                
-                // Clear and populate spatial grid
-                spatialGrid.clear();
-                for (int i = 0; i < activeParticles; i++) {
-                    spatialGrid.addParticle(i, positions[i * 2], positions[i * 2 + 1]);
-                }
-                
-                for (int i = 0; i < activeParticles; i++) {
-                    x = positions[i * 2];
-                    y = positions[i * 2 + 1];
-                    
-                    nearby = spatialGrid.getNearbyParticles(x, y, radius * 2.0f);
-                    
-                    for (int j : nearby) {
-                        if (i >= j) continue; // Avoid duplicate checks and self-collision
-                        g_profiler.collisionCheck++;
-
-                        dx = x - positions[j * 2];
-                        dy = y - positions[j * 2 + 1];
-                        distanceSquared = dx * dx + dy * dy;
-                        
-                        if (distanceSquared < radiusSumSquared && distanceSquared > precision) {
-                            g_profiler.collisionVerified++;
-
-                            distance = sqrtf(distanceSquared); 
-                            overlap = radiusSum - distance;
-                            separation = overlap * 0.25f / distance;
-                            
-                            positions[i * 2] += dx * separation;
-                            positions[i * 2 + 1] += dy * separation;
-                            positions[j * 2] -= dx * separation;
-                            positions[j * 2 + 1] -= dy * separation;
-                        }
-                    }
-                }
+        logEntry.collisionMode = static_cast<int>(simulation.getCollisionMode());
+        logEntry.substeps = simulation.getSubsteps();
+        {
+            PROFILE_SCOPE(g_profiler, "Simulation Step");
+            simulation.step();
+        }
+        logEntry.checksum = simulation.getChecksum();
+        hud.addFrameTime(actualDeltaTime * 1000.0f);
+        updateAnalytics(analytics, simulation, options.analyticsInterval, analyticsFile.get());
+
+        // Collision counters of this frame, the profiler sums them until the next report
+        int frameChecks = g_profiler.collisionCheck - countedChecks;
+        int frameContacts = g_profiler.collisionVerified - countedContacts;
+        countedChecks = g_profiler.collisionCheck;
+        countedContacts = g_profiler.collisionVerified;
+
+        if ((!colliders.isEmpty() || !kinematic.empty()) && (backgroundWidth != SRC_WIDTH || backgroundHeight != SRC_HEIGHT)) {
+            paintColliders(colliders, SRC_WIDTH, SRC_HEIGHT, background);
+            colliderLayer.reset(background, SRC_WIDTH, SRC_HEIGHT);
+            uploadSoftwareFrame(renderer.background, reinterpret_cast<const uint8_t*>(background.data()), SRC_WIDTH, SRC_HEIGHT);
+            rasterizer.setBackground(colliderLayer.data());
+            density.setBackground(colliderLayer.data());
+            backgroundWidth = SRC_WIDTH;
+            backgroundHeight = SRC_HEIGHT;
+        }
+        if (!kinematic.empty()) {
+            PROFILE_SCOPE(g_profiler, "Kinematic Layer");
+            for (const PixelRect& rect : paintKinematicColliders(colliderLayer, simulation.getKinematicColliders(), background)) {
+                uploadSoftwareFrameRect(renderer.background, colliderLayer.data(), rect);
             }
         }
 
         // GPU buffer update and rendering
         {
             PROFILE_SCOPE(g_profiler, "Rendering");
-            glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
-            glBufferSubData(GL_ARRAY_BUFFER, 0, positions.size() * sizeof(float), positions.data());
-            
-            // clearing the screen
-            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-            // Use our shader program
-            glUseProgram(shaderProgram);
-            
-            // Bind the VAO and draw all instances
-            glBindVertexArray(VAO);
-            glDrawElementsInstanced(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0, NUMCIRCLES - remainingCirclesToSpawn);
-        }
-
-        // process input from keyboard
-        processInput(window, acceleration);
-
-        // Frame rate limiting to 60 FPS with fixed timestep
-        auto frameEndTime = std::chrono::steady_clock::now();
-        auto frameTime = frameEndTime - frameStartTime;
-        auto targetFrameTime = std::chrono::duration<float>(1.0f / TARGET_FPS);
-        
-        if (frameTime < targetFrameTime) {
-            auto remainingTime = targetFrameTime - frameTime;
-            auto sleepMicroseconds = std::chrono::duration_cast<std::chrono::microseconds>(remainingTime);
-            if (sleepMicroseconds.count() > 0) {
-                usleep(sleepMicroseconds.count());
+            gpuTimer.beginFrame();
+            if (options.renderer == "software") {
+                rasterizer.resize(SRC_WIDTH, SRC_HEIGHT);
+                rasterizer.render(simulation.getThreadPool(), simulation.getWorldPositions(),
+                                  renderer.radiusColorData.data(), simulation.getParticleCount());
+                presentSoftwareFrame(softwareFrame, rasterizer.data(), SRC_WIDTH, SRC_HEIGHT, gpuTimer);
+            } else if (options.renderer == "density") {
+                density.resize(SRC_WIDTH, SRC_HEIGHT);
+                density.render(simulation.getThreadPool(), simulation.getGrid(), simulation.getWorldPositions());
+                presentSoftwareFrame(softwareFrame, density.data(), SRC_WIDTH, SRC_HEIGHT, gpuTimer);
+            } else {
+                drawParticles(renderer, gpuTimer, simulation.getWorldPositions(), simulation.getWorldLastPositions(),
+                              simulation.getParticleCount(), governor.current().lod, simulation.getStepTime());
             }
         }
 
+        if (hud.isVisible()) {
+            PROFILE_SCOPE(g_profiler, "HUD");
+            PROFILE_GPU_SCOPE(gpuTimer, "GPU HUD");
+            hud.draw(SRC_WIDTH, SRC_HEIGHT, hudSegments(simulation), hudLines(simulation, hud, frameChecks, frameContacts));
+        }
+
+        // process input from keyboard, it takes effect from the next frame on
+        FrameInput input = processInput(window, simulation, hud, nextPipeline);
+        if (recorder.isOpen() && !samePipeline(nextPipeline, pipelines.currentSpec())) {
+            std::cout << "Pipeline switches are off while recording, the log replays on one pipeline" << std::endl;
+            nextPipeline = pipelines.currentSpec();
+        }
+        simulation.applyInput(input);
+        latency.inputConsumed();
+        if (recorder.isOpen()) {
+            logEntry.keys = inputKeys(input);
+            recorder.record(logEntry);
+        }
+
+        // --ab: the next listed pipeline every abFrames frames
+        if (options.abPipelines.size() > 1 && ++abFrames >= options.abFrames) {
+            abIndex = (abIndex + 1) % options.abPipelines.size();
+            nextPipeline = options.abPipelines[abIndex];
+            abFrames = 0;
+        }
+
+        // Trade quality for frame time, substep changes take effect on the next step
+        if (options.governor && governor.update(g_profiler, collisionScopeName(simulation.getCollisionMode()),
+                                                   !simulation.getKinematicColliders().empty(), options.analyticsInterval)) {
+            simulation.setSubsteps(governor.current().substeps);
+        }
+
         frames++;
         if(std::chrono::steady_clock::now() - fpsTimer > std::chrono::seconds(1)){
-            std::string title = "FPS: " + std::to_string(static_cast<int>(frames)) + " Particles: " + std::to_string(NUMCIRCLES - remainingCirclesToSpawn);
+            std::string title = "FPS: " + std::to_string(static_cast<int>(frames)) + " Particles: " + std::to_string(simulation.getParticleCount());
             glfwSetWindowTitle(window, title.c_str());
 
-            // Print detailed performance stats every 5 seconds
+            // Print detailed performance stats every few seconds, less often when the governor is saving time
             static int statsCounter = 0;
             statsCounter++;
-            if (statsCounter >= 5) {
+            if (statsCounter >= governor.current().statsIntervalSeconds) {
                 g_profiler.printStats();
                 g_profiler.printMemoryUsage();
+                particleArena().printStats();
                 g_profiler.printCollisionStats();
+                countedChecks = 0;
+                countedContacts = 0;
+                simulation.printStats();
+                if (collisionEvents) collisionEvents->printStats();
+                analytics.printStats();
+                commands.printStats();
+                g_profiler.printBackendComparison();
+                pacer.printStats();
+                latency.printStats();
+                if (gpuTimer.getDroppedFrames() > 0) {
+                    std::cout << "GPU Timer: " << gpuTimer.getDroppedFrames() << " frames dropped, results were not ready" << std::endl;
+                }
+                if (recorder.isOpen()) recorder.flush();
                 statsCounter = 0;
             }
 
@@ -320,14 +500,428 @@ int main(void) {
             frames = 1;
         }
 
-        glfwSwapBuffers(window);
+        {
+            int swapScope = GPU_TIME_SWAP ? gpuTimer.begin("GPU Swap") : -1;
+            glfwSwapBuffers(window);
+            gpuTimer.end(swapScope);
+        }
+        latency.framePresented();
         glfwPollEvents();
+
+        // Frame rate limiting to TARGET_FPS, measured from one swap to the next
+        pacer.waitForNextFrame();
     }
 
     glfwTerminate();
     return 0;
 }
 
+// Re-runs a recorded session frame by frame without a window, so a bad
+// session can be profiled and its checksums compared with the recording
+int runReplay(const RunOptions& options, std::chrono::steady_clock::time_point startupBegin) {
+    InputLogReader reader;
+    InputLogHeader header;
+    if (!reader.open(options.replayPath, header)) {
+        std::cout << "Failed to read input log: " << options.replayPath << std::endl;
+        return -1;
+    }
+
+    // The recorded pipeline and thread count are the defaults, Parallel collisions depend on both
+    // With --ab the first listed pipeline
+    PipelineSpec startPipeline;
+    startPipeline.threads = options.threadsSet ? options.threads : header.threads;
+    startPipeline.layout = options.pipelineSet ? options.layout : header.layout;
+    startPipeline.integrator = options.pipelineSet ? options.integrator : header.integrator;
+    if (!options.abPipelines.empty()) startPipeline = options.abPipelines[0];
+    const std::string& layout = startPipeline.layout;
+    const std::string& integrator = startPipeline.integrator;
+
+    PipelineSwitcher pipelines(options.pinThreads, header.seed);
+    pipelines.retain(options.abPipelines);
+    SimulationBase* firstPipeline = pipelines.start(startPipeline, COLLISION_MODE);
+    if (!firstPipeline) {
+        std::cout << "Unknown pipeline " << layout << "/" << integrator
+                  << ", available: " << availableSimulations() << std::endl;
+        return -1;
+    }
+    if (options.abPipelines.size() > 1) {
+        std::cout << "Warning: --ab switches pipelines every " << options.abFrames
+                  << " frames; checksums only match while the pipeline matches the recording" << std::endl;
+    }
+    if (layout != header.layout || integrator != header.integrator) {
+        std::cout << "Warning: replaying on " << layout << "/" << integrator << ", recorded on "
+                  << header.layout << "/" << header.integrator << "; checksums will not match" << std::endl;
+    }
+    if (firstPipeline->getThreadCount() != header.threads) {
+        std::cout << "Warning: replaying with " << firstPipeline->getThreadCount() << " threads, recorded with "
+                  << header.threads << "; Parallel mode frames may diverge" << std::endl;
+    }
+
+    // The recorded scene unless --scene overrides it
+    std::string sceneName = options.sceneSet ? options.scene : header.scene;
+    if (sceneName != header.scene) {
+        std::cout << "Warning: replaying in scene " << sceneName << ", recorded in " << header.scene
+                  << "; checksums will not match" << std::endl;
+    }
+    SignedDistanceField colliders;
+    std::vector<KinematicCollider> kinematic;
+    if (!bakeColliders(sceneName, colliders, kinematic)) return -1;
+    firstPipeline->setColliders(&colliders);
+    firstPipeline->setKinematicColliders(kinematic);
+
+    // The recorded force field unless --field overrides it
+    std::string fieldName = options.fieldSet ? options.field : header.field;
+    if (fieldName != header.field) {
+        std::cout << "Warning: replaying in force field " << fieldName << ", recorded in " << header.field
+                  << "; checksums will not match" << std::endl;
+    }
+    if (header.version < INPUT_LOG_SCENE_GRAVITY_VERSION) {
+        std::cout << "Warning: version " << header.version << " log, W and D changed each particle's gravity then;"
+                  << " frames after the first key press will not match" << std::endl;
+    }
+    ForceField forceField;
+    if (!loadForceField(fieldName, forceField)) return -1;
+    firstPipeline->setForceField(&forceField);
+    std::unique_ptr<CollisionEventStream> collisionEvents;
+    if (options.events) {
+        collisionEvents = startCollisionEvents(options, startPipeline);
+        if (!collisionEvents) return -1;
+        firstPipeline->setCollisionEvents(collisionEvents.get());
+    }
+    GridAnalytics analytics(ANALYTICS_CELLS_PER_BIN, ANALYTICS_CONTACT_DISTANCE);
+    std::shared_ptr<FILE> analyticsFile;
+    if (!openAnalytics(options, analyticsFile)) return -1;
+
+    std::cout << "Replaying " << options.replayPath << " (seed " << header.seed << ", "
+              << firstPipeline->getThreadCount() << " threads, " << layout << "/" << integrator << ")" << std::endl;
+    firstPipeline->printPlacement();
+
+    // Optional video of the replay, rendered without a window, by GL or on the CPU
+    bool recordVideo = !options.videoPath.empty();
+    std::unique_ptr<OffscreenContext> offscreen;
+    std::unique_ptr<ShaderCache> shaderCache;
+    std::unique_ptr<ParticleRenderer> renderer;
+    std::unique_ptr<GpuTimer> gpuTimer;
+    VideoWriter video;
+    std::unique_ptr<PboFrameCapture> capture;
+    std::unique_ptr<SoftwareRasterizer> rasterizer;
+    std::unique_ptr<DensityRenderer> density;
+    std::vector<float> radiusColorData;
+    std::vector<uint32_t> background;
+    KinematicLayer colliderLayer;
+    bool drawColliders = !colliders.isEmpty() || !kinematic.empty();
+    if (recordVideo) {
+        paintColliders(colliders, SRC_WIDTH, SRC_HEIGHT, background);
+        colliderLayer.reset(background, SRC_WIDTH, SRC_HEIGHT);
+        if (options.renderer == "software") {
+            rasterizer.reset(new SoftwareRasterizer());
+            rasterizer->resize(SRC_WIDTH, SRC_HEIGHT);
+            if (drawColliders) rasterizer->setBackground(colliderLayer.data());
+        } else if (options.renderer == "density") {
+            density.reset(new DensityRenderer());
+            density->resize(SRC_WIDTH, SRC_HEIGHT);
+            if (drawColliders) density->setBackground(colliderLayer.data());
+        } else {
+            PROFILE_SCOPE(g_profiler, "Startup: GL Context");
+            offscreen.reset(new OffscreenContext());
+            if (!offscreen->create(SRC_WIDTH, SRC_HEIGHT)) return -1;
+        }
+        if (!video.open(options.videoPath, SRC_WIDTH, SRC_HEIGHT, static_cast<int>(TARGET_FPS))) {
+            std::cout << "Failed to open video output: " << options.videoPath << std::endl;
+            return -1;
+        }
+        std::string device;
+        if (!offscreen) {
+            device = options.renderer + ", " + std::to_string(firstPipeline->getThreadCount()) + " threads";
+        } else {
+            shaderCache.reset(new ShaderCache(options.shaderCache ? SHADER_CACHE_FILE : "", vertexShaderSource, fragmentShaderSource));
+            renderer.reset(new ParticleRenderer());
+            createParticleRenderer(*renderer, *shaderCache);
+            if (drawColliders) {
+                uploadSoftwareFrame(renderer->background, reinterpret_cast<const uint8_t*>(background.data()), SRC_WIDTH, SRC_HEIGHT);
+            }
+            gpuTimer.reset(new GpuTimer(g_profiler));
+            capture.reset(new PboFrameCapture(video, SRC_WIDTH, SRC_HEIGHT));
+            device = reinterpret_cast<const char*>(glGetString(GL_RENDERER));
+        }
+        std::cout << "Rendering " << SRC_WIDTH << "x" << SRC_HEIGHT << " " << video.formatName() << " video to "
+                  << options.videoPath << " (" << device << ")" << std::endl;
+        if (shaderCache) printStartupStats(*shaderCache, startupBegin);
+    }
+
+    g_profiler.collisionCheck = 0;
+    g_profiler.collisionVerified = 0;
+
+    InputLogEntry entry;
+    long long replayedFrames = 0;
+    long long divergedFrame = -1;
+    auto replayStart = std::chrono::steady_clock::now();
+    g_profiler.setBackend(pipelineLabel(*firstPipeline));
+    size_t abIndex = 0;
+
+    while (reader.next(entry)) {
+        if (options.abPipelines.size() > 1 && replayedFrames > 0 && replayedFrames % options.abFrames == 0) {
+            abIndex = (abIndex + 1) % options.abPipelines.size();
+            if (pipelines.switchTo(options.abPipelines[abIndex])) g_profiler.setBackend(pipelineLabel(pipelines.current()));
+        }
+        SimulationBase& simulation = pipelines.current();
+
+        for (const std::string& text : entry.commands) {
+            Command command;
+            std::string error;
+            if (!parseCommand(text, command, error)) {
+                std::cout << "Invalid command at frame " << entry.frame << ": " << error << std::endl;
+                return -1;
+            }
+            simulation.applyCommand(command);
+        }
+        if (entry.spawnCount > 0) {
+            simulation.spawn(entry.spawnCount, entry.spawnLayoutHeight);
+        }
+        if (entry.collisionMode < 0 || entry.collisionMode > 2) {
+            std::cout << "Invalid collision mode " << entry.collisionMode << " at frame " << entry.frame << std::endl;
+            return -1;
+        }
+        simulation.setCollisionMode(static_cast<CollisionMode>(entry.collisionMode));
+        if (entry.substeps < 1 || entry.substeps > UPDATER_PER_FRAME || (entry.substeps & (entry.substeps - 1)) != 0) {
+            std::cout << "Invalid substep count " << entry.substeps << " at frame " << entry.frame << std::endl;
+            return -1;
+        }
+        simulation.setSubsteps(entry.substeps);
+        {
+            PROFILE_SCOPE(g_profiler, "Simulation Step");
+            simulation.step();
+        }
+
+        if (divergedFrame < 0 && simulation.getChecksum() != entry.checksum) {
+            divergedFrame = entry.frame;
+            printf("Replay diverged at frame %lld: 0x%016llx, recorded 0x%016llx\n", entry.frame,
+                   static_cast<unsigned long long>(simulation.getChecksum()),
+                   static_cast<unsigned long long>(entry.checksum));
+        }
+        updateAnalytics(analytics, simulation, options.analyticsInterval, analyticsFile.get());
+
+        if (recordVideo) {
+            PROFILE_SCOPE(g_profiler, "Video Frame");
+            if (!kinematic.empty()) {
+                for (const PixelRect& rect : paintKinematicColliders(colliderLayer, simulation.getKinematicColliders(), background)) {
+                    if (renderer) uploadSoftwareFrameRect(renderer->background, colliderLayer.data(), rect);
+                }
+            }
+            if (rasterizer) {
+                appendStaticData(radiusColorData, simulation.getParticleCount());
+                rasterizer->render(simulation.getThreadPool(), simulation.getWorldPositions(), radiusColorData.data(),
+                                   simulation.getParticleCount());
+                video.writeFrame(rasterizer->data());
+            } else if (density) {
+                density->render(simulation.getThreadPool(), simulation.getGrid(), simulation.getWorldPositions());
+                video.writeFrame(density->data());
+            } else {
+                if (entry.spawnCount > 0 || !entry.commands.empty()) addSpawnedParticles(*renderer, simulation.getParticleCount());
+                gpuTimer->beginFrame();
+                drawParticles(*renderer, *gpuTimer, simulation.getWorldPositions(), simulation.getWorldLastPositions(),
+                              simulation.getParticleCount(), 0, simulation.getStepTime());
+                capture->capture();
+            }
+        }
+
+        simulation.applyInput(frameInputFromKeys(entry.keys));
+        replayedFrames++;
+
+        if (replayedFrames % REPLAY_STATS_INTERVAL == 0) {
+            g_profiler.printStats();
+            g_profiler.printCollisionStats();
+            simulation.printStats();
+            if (collisionEvents) collisionEvents->printStats();
+            analytics.printStats();
+            g_profiler.printBackendComparison();
+        }
+    }
+
+    if (capture) capture->finish();
+    std::chrono::duration<double, std::milli> replayTime = std::chrono::steady_clock::now() - replayStart;
+    if (collisionEvents) collisionEvents->stop(); // Everything consumed before the last report
+
+    g_profiler.printStats();
+    g_profiler.printMemoryUsage();
+    particleArena().printStats();
+    g_profiler.printCollisionStats();
+    pipelines.current().printStats();
+    if (collisionEvents) collisionEvents->printStats();
+    analytics.printStats();
+    g_profiler.printBackendComparison();
+
+    std::cout << "\n=== Replay ===" << std::endl;
+    std::cout << "Frames: " << replayedFrames << std::endl;
+    std::cout << "Time: " << replayTime.count() << "ms ("
+              << (replayedFrames > 0 ? replayTime.count() / replayedFrames : 0.0) << "ms/frame)" << std::endl;
+    if (capture) {
+        std::cout << "Video: " << video.getFrameCount() << " frames, " << capture->getStalls() << " readback stalls" << std::endl;
+    } else if (recordVideo) {
+        std::cout << "Video: " << video.getFrameCount() << " frames" << std::endl;
+    }
+    if (divergedFrame < 0) {
+        std::cout << "Checksums: all frames match the recording" << std::endl;
+    } else {
+        std::cout << "Checksums: diverged from frame " << divergedFrame << std::endl;
+    }
+    return divergedFrame < 0 ? 0 : 1;
+}
+
+// Cold (compiled shaders) versus warm (cached program binary) startup
+void printStartupStats(const ShaderCache& shaderCache, std::chrono::steady_clock::time_point startupBegin) {
+    std::chrono::duration<double, std::milli> total = std::chrono::steady_clock::now() - startupBegin;
+    std::cout << "\n=== Startup ===" << std::endl;
+    for (const char* phase : STARTUP_PHASES) {
+        double time = g_profiler.getAverageTime(phase);
+        if (time > 0.0) printf("%-28s %8.2f ms\n", phase, time / 1000.0);
+    }
+    printf("Startup: %.2f ms, shaders %s\n", total.count(), shaderCache.status());
+}
+
+bool parseArguments(int argc, char** argv, RunOptions& options) {
+    for (int i = 1; i < argc; i++) {
+        bool hasValue = i + 1 < argc;
+        if (std::strcmp(argv[i], "--record") == 0 && hasValue) {
+            options.recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--replay") == 0 && hasValue) {
+            options.replayPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--seed") == 0 && hasValue) {
+            options.seed = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+            options.seedSet = true;
+        } else if (std::strcmp(argv[i], "--threads") == 0 && hasValue) {
+            options.threads = std::atoi(argv[++i]);
+            options.threadsSet = true;
+        } else if (std::strcmp(argv[i], "--pin") == 0) {
+            options.pinThreads = true;
+        } else if (std::strcmp(argv[i], "--realtime") == 0) {
+            options.realtime = true;
+        } else if (std::strcmp(argv[i], "--video") == 0 && hasValue) {
+            options.videoPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--renderer") == 0 && hasValue) {
+            options.renderer = argv[++i];
+            if (options.renderer != "gl" && options.renderer != "software" && options.renderer != "density") {
+                std::cout << "Unknown renderer: " << options.renderer << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--no-shader-cache") == 0) {
+            options.shaderCache = false;
+        } else if (std::strcmp(argv[i], "--governor") == 0) {
+            options.governor = true;
+        } else if (std::strcmp(argv[i], "--no-governor") == 0) {
+            options.governor = false;
+        } else if (std::strcmp(argv[i], "--layout") == 0 && hasValue) {
+            options.layout = argv[++i];
+            options.pipelineSet = true;
+        } else if (std::strcmp(argv[i], "--integrator") == 0 && hasValue) {
+            options.integrator = argv[++i];
+            options.pipelineSet = true;
+        } else if (std::strcmp(argv[i], "--scene") == 0 && hasValue) {
+            options.scene = argv[++i];
+            options.sceneSet = true;
+        } else if (std::strcmp(argv[i], "--field") == 0 && hasValue) {
+            options.field = argv[++i];
+            options.fieldSet = true;
+        } else if (std::strcmp(argv[i], "--ab") == 0 && hasValue) {
+            std::string list = argv[++i];
+            for (size_t begin = 0; begin <= list.size();) {
+                size_t end = std::min(list.find(',', begin), list.size());
+                PipelineSpec spec;
+                if (!parsePipelineSpec(list.substr(begin, end - begin), spec)) {
+                    std::cout << "Invalid pipeline in --ab: " << list.substr(begin, end - begin) << std::endl;
+                    return false;
+                }
+                options.abPipelines.push_back(spec);
+                begin = end + 1;
+            }
+        } else if (std::strcmp(argv[i], "--ab-frames") == 0 && hasValue) {
+            options.abFrames = std::atoi(argv[++i]);
+            if (options.abFrames < 1) {
+                std::cout << "--ab-frames needs at least 1 frame" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--events") == 0 && hasValue) {
+            options.eventsPath = argv[++i];
+            options.events = true;
+        } else if (std::strcmp(argv[i], "--event-impulse") == 0 && hasValue) {
+            options.eventImpulse = static_cast<float>(std::atof(argv[++i]));
+            options.events = true;
+            if (options.eventImpulse <= 0.0f) {
+                std::cout << "--event-impulse needs a positive impulse" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--analytics") == 0 && hasValue) {
+            options.analyticsPath = argv[++i];
+            if (options.analyticsInterval == 0) options.analyticsInterval = ANALYTICS_INTERVAL_FRAMES;
+        } else if (std::strcmp(argv[i], "--analytics-interval") == 0 && hasValue) {
+            options.analyticsInterval = std::atoi(argv[++i]);
+            if (options.analyticsInterval < 1) {
+                std::cout << "--analytics-interval needs at least 1 frame" << std::endl;
+                return false;
+            }
+        } else if (std::strcmp(argv[i], "--control") == 0 && hasValue) {
+            options.controlPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--config") == 0 && hasValue) {
+            options.configPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--pages") == 0 && hasValue) {
+            if (!parsePageMode(argv[++i], options.pageMode)) {
+                std::cout << "Unknown page mode: " << argv[i] << std::endl;
+                return false;
+            }
+        } else {
+            std::cout << "Unknown or incomplete option: " << argv[i] << std::endl;
+            return false;
+        }
+    }
+    if (!options.recordPath.empty() && !options.replayPath.empty()) {
+        std::cout << "--record and --replay cannot be combined" << std::endl;
+        return false;
+    }
+    if (!options.abPipelines.empty() && !options.recordPath.empty()) {
+        std::cout << "--ab switches pipelines, which a recording cannot replay" << std::endl;
+        return false;
+    }
+    if ((!options.controlPath.empty() || !options.configPath.empty()) && !options.replayPath.empty()) {
+        std::cout << "--control and --config change a live run, a replay applies the recorded commands" << std::endl;
+        return false;
+    }
+    if (!options.videoPath.empty() && options.replayPath.empty()) {
+        std::cout << "--video renders a replay, it needs --replay" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " [options]\n"
+              << "  --record <file>   Log spawns and input of every frame to <file>\n"
+              << "  --replay <file>   Re-run a recorded log headless and verify its checksums\n"
+              << "  --video <file>    With --replay: render offscreen to .y4m, .ppm or - (y4m on stdout)\n"
+              << "  --renderer <name> gl (instanced circles), software (tiled CPU rasterizer) or density (heatmap)\n"
+              << "  --seed <n>        Random seed (recorded in the log)\n"
+              << "  --threads <n>     Worker threads, 0 = one per hardware thread\n"
+              << "  --pin             Pin threads to CPUs, filling one NUMA node after another\n"
+              << "  --realtime        SCHED_FIFO render thread and locked memory (needs privileges)\n"
+              << "  --governor        Hold the frame budget by lowering circle detail, then substeps\n"
+              << "  --no-governor     Keep full quality (the default)\n"
+              << "  --no-shader-cache Always compile the shaders (cold start), " << SHADER_CACHE_FILE << " is left alone\n"
+              << "  --layout <name>   Position layout: float or fixed (default " << DEFAULT_LAYOUT << ")\n"
+              << "  --integrator <n>  multirate or uniform (default " << DEFAULT_INTEGRATOR << ")\n"
+              << "  --scene <name>    Colliders: " << builtinColliderScenes() << " or a scene file (default " << DEFAULT_SCENE << ")\n"
+              << "  --field <name>    Force field: " << builtinForceFields() << " or a field file (default " << DEFAULT_FORCE_FIELD << ")\n"
+              << "  --ab <a>,<b>...   Alternate the scene between pipelines (layout/integrator[/threads]) and\n"
+              << "                    compare their timings; L, I and T switch layout, integrator and threads live\n"
+              << "  --ab-frames <n>   Frames on each --ab pipeline before the next (default " << AB_SWITCH_FRAMES << ")\n"
+              << "  --events <file>   Write impacts above the event impulse to <file> from a consumer thread\n"
+              << "  --event-impulse <x> Event threshold, alone it only counts them (default " << COLLISION_EVENT_IMPULSE << ")\n"
+              << "  --analytics <file> Write density, velocity, temperature and coordination per grid block to <file>\n"
+              << "  --analytics-interval <n> Frames between analytics passes, alone only prints them (default " << ANALYTICS_INTERVAL_FRAMES << ")\n"
+              << "  --control <socket> Accept command lines (gravity, damping, spawn, remove, mode...) on a Unix socket\n"
+              << "  --config <file>   Apply the commands in <file> at startup and again whenever it changes\n"
+              << "  --pages <mode>    Particle storage pages: 4k, thp or hugetlb (default " << pageModeName(ARENA_PAGE_MODE) << ")\n"
+              << "Pipelines: " << availableSimulations() << std::endl;
+}
+
 void framebuffer_size_callback(GLFWwindow* window, int newWidth, int newHeight)
 {
 	glViewport(0, 0, newWidth, newHeight);
@@ -336,60 +930,381 @@ void framebuffer_size_callback(GLFWwindow* window, int newWidth, int newHeight)
     //std::cout << "New resolution: " << SRC_WIDTH << "x" << SRC_HEIGHT << std::endl;
 }
 
-void processInput(GLFWwindow *window, std::vector<float>& acceleration){
+// Presses of the keys that change the simulation start an input latency sample
+void key_callback(GLFWwindow* window, int key, int, int action, int)
+{
+    if (action != GLFW_PRESS) return;
+    if (key == GLFW_KEY_W || key == GLFW_KEY_D) {
+        static_cast<InputLatencyTracker*>(glfwGetWindowUserPointer(window))->keyPressed();
+    }
+}
+
+// pipeline is the pipeline for the next frame; L, I and T change its layout,
+// integrator and thread count
+FrameInput processInput(GLFWwindow *window, SimulationBase& simulation, Hud& hud, PipelineSpec& pipeline){
     if(glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    if(glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
-        for(int i = 0; i < NUMCIRCLES; i++) {
-            acceleration[i * 2 + 1] = -acceleration[i * 2 + 1]; // Reverse Y acceleration
+    // Cycle collision modes once per key press
+    static bool modeKeyDown = false;
+    bool modeKeyPressed = glfwGetKey(window, GLFW_KEY_M) == GLFW_PRESS;
+    if(modeKeyPressed && !modeKeyDown) {
+        CollisionMode collisionMode = static_cast<CollisionMode>((static_cast<int>(simulation.getCollisionMode()) + 1) % 3);
+        simulation.setCollisionMode(collisionMode);
+        std::cout << "Collision mode: " << collisionScopeName(collisionMode) << std::endl;
+    }
+    modeKeyDown = modeKeyPressed;
+
+    static bool layoutKeyDown = false, integratorKeyDown = false, threadsKeyDown = false;
+    bool layoutKeyPressed = glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS;
+    bool integratorKeyPressed = glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS;
+    bool threadsKeyPressed = glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS;
+    if(layoutKeyPressed && !layoutKeyDown) pipeline.layout = nextLayout(pipeline.layout, pipeline.integrator);
+    if(integratorKeyPressed && !integratorKeyDown) pipeline.integrator = nextIntegrator(pipeline.layout, pipeline.integrator);
+    if(threadsKeyPressed && !threadsKeyDown) pipeline.threads = nextThreadCount(resolveThreadCount(pipeline.threads));
+    layoutKeyDown = layoutKeyPressed;
+    integratorKeyDown = integratorKeyPressed;
+    threadsKeyDown = threadsKeyPressed;
+
+    // The HUD is display only, so its key is not part of the recorded input
+    static bool hudKeyDown = false;
+    bool hudKeyPressed = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
+    if(hudKeyPressed && !hudKeyDown) hud.toggle();
+    hudKeyDown = hudKeyPressed;
+
+    FrameInput input;
+    input.reverseGravity = glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS;
+    input.pushLeft = glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS;
+    return input;
+}
+
+// CPU frame cost by phase from the profiler averages, added up like the quality governor does
+std::vector<HudSegment> hudSegments(SimulationBase& simulation) {
+    double substeps = simulation.getSubsteps();
+    std::vector<HudSegment> segments = {
+        { "Levels", g_profiler.getAverageTime("Time Level Assignment") / 1000.0, 0.6f, 0.6f, 0.6f },
+        { "Verlet", g_profiler.getAverageTime("Verlet Integration") * substeps / 1000.0, 0.3f, 0.6f, 1.0f },
+        { "Walls", g_profiler.getAverageTime("Wall Collisions") * substeps / 1000.0, 0.7f, 0.4f, 1.0f },
+        { "Collide", g_profiler.getAverageTime(collisionScopeName(simulation.getCollisionMode())) * substeps / 1000.0, 1.0f, 0.6f, 0.2f },
+        { "Render", g_profiler.getAverageTime("Rendering") / 1000.0, 0.4f, 0.9f, 0.4f }
+    };
+    if (!simulation.getKinematicColliders().empty()) {
+        HudSegment movers = { "Movers", g_profiler.getAverageTime("Kinematic Colliders") * substeps / 1000.0, 0.9f, 0.5f, 0.4f };
+        segments.insert(segments.end() - 1, movers);
+    }
+    return segments;
+}
+
+std::vector<std::string> hudLines(SimulationBase& simulation, const Hud& hud, int collisionChecks, int collisionContacts) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    float frameMs = hud.getAverageFrameTime();
+    char line[5][64];
+    snprintf(line[0], sizeof(line[0]), "FPS %.0f  FRAME %.2f MS", frameMs > 0.0f ? 1000.0f / frameMs : 0.0f, frameMs);
+    snprintf(line[1], sizeof(line[1]), "PARTICLES %d  SUBSTEPS %d", simulation.getParticleCount(), simulation.getSubsteps());
+    snprintf(line[2], sizeof(line[2]), "CHECKS %d  CONTACTS %d", collisionChecks, collisionContacts);
+    snprintf(line[3], sizeof(line[3]), "ARENA %zu KB  RSS %ld MB", particleArena().getUsedBytes() / 1024, usage.ru_maxrss / 1024);
+    snprintf(line[4], sizeof(line[4]), "%s", g_profiler.getBackend().c_str());
+    return std::vector<std::string>(line, line + 5);
+}
+
+int inputKeys(const FrameInput& input) {
+    return (input.reverseGravity ? INPUT_KEY_REVERSE_GRAVITY : 0) | (input.pushLeft ? INPUT_KEY_PUSH_LEFT : 0);
+}
+
+FrameInput frameInputFromKeys(int keys) {
+    FrameInput input;
+    input.reverseGravity = (keys & INPUT_KEY_REVERSE_GRAVITY) != 0;
+    input.pushLeft = (keys & INPUT_KEY_PUSH_LEFT) != 0;
+    return input;
+}
+
+// Circle meshes, instance buffers and the shader program; needs a current GL context
+void createParticleRenderer(ParticleRenderer& renderer, ShaderCache& shaderCache) {
+    std::vector<float> circleVertices;
+    std::vector<float> initialPositions; // Empty, the GL buffer is filled once circles spawn
+    unsigned int vertexShader = 0, fragmentShader = 0;
+
+    {
+        PROFILE_SCOPE(g_profiler, "Startup: Buffers");
+        // generating circle by composing them of smaller triangles, once per LOD
+        creatingCircles(circleVertices, renderer.indices, renderer.circleLods);
+
+        // the first circles are spawned at the start of the first frame
+        genAndBindBuffers(renderer.VAO, renderer.positionVBO, renderer.lastPositionVBO, renderer.radiusColorVBO, initialPositions,
+                          renderer.radiusColorData, renderer.indices, circleVertices);
+    }
+
+    {
+        PROFILE_SCOPE(g_profiler, "Startup: Shader Cache Load");
+        renderer.shaderProgram = shaderCache.load();
+    }
+    if (renderer.shaderProgram == 0) {
+        PROFILE_SCOPE(g_profiler, "Startup: Shader Compile");
+        vertexShader = creatingVertexShader(vertexShader);
+
+        fragmentShader = creatingFragmentShader(fragmentShader);
+
+        renderer.shaderProgram = creatingShaderProgram(renderer.shaderProgram, fragmentShader, vertexShader);
+
+        // delete the shaders as they're linked into our program now and no longer necessary
+        glDeleteShader(vertexShader);
+        glDeleteShader(fragmentShader);
+
+        shaderCache.store(renderer.shaderProgram);
+    }
+    renderer.speedScaleLocation = glGetUniformLocation(renderer.shaderProgram, "speedScale");
+
+    // Unbind VAO
+    glBindVertexArray(0);
+
+    glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // RGBA values
+}
+
+void addSpawnedParticles(ParticleRenderer& renderer, int particleCount) {
+    appendStaticData(renderer.radiusColorData, particleCount);
+
+    // Update radius/color buffer with new data
+    glBindBuffer(GL_ARRAY_BUFFER, renderer.radiusColorVBO);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, renderer.radiusColorData.size() * sizeof(float), renderer.radiusColorData.data());
+}
+
+// Speed coloring needs nothing on the CPU but the upload of the previous positions
+void drawParticles(ParticleRenderer& renderer, GpuTimer& gpuTimer, const float* positions, const float* lastPositions,
+                   int particleCount, int lod, float stepTime) {
+    {
+        PROFILE_GPU_SCOPE(gpuTimer, "GPU Upload");
+        glBindBuffer(GL_ARRAY_BUFFER, renderer.positionVBO);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, particleCount * 2 * sizeof(float), positions);
+        if (VELOCITY_COLORING) {
+            glBindBuffer(GL_ARRAY_BUFFER, renderer.lastPositionVBO);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, particleCount * 2 * sizeof(float), lastPositions);
         }
     }
 
-    if(glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS) {
-        for(int i = 0; i < NUMCIRCLES; i++) {
-            acceleration[i * 2] = -5.0f; // Reverse X acceleration
+    PROFILE_GPU_SCOPE(gpuTimer, "GPU Draw");
+
+    // clearing the screen, or drawing the colliders over all of it
+    if (renderer.background.texture) {
+        blitSoftwareFrame(renderer.background);
+    } else {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // Use our shader program
+    glUseProgram(renderer.shaderProgram);
+    glUniform1f(renderer.speedScaleLocation, VELOCITY_COLORING ? 1.0f / (stepTime * SPEED_COLOR_MAX) : 0.0f);
+
+    // Bind the VAO and draw all instances
+    const CircleLod& mesh = renderer.circleLods[lod];
+    glBindVertexArray(renderer.VAO);
+    glDrawElementsInstanced(GL_TRIANGLES, mesh.indexCount, GL_UNSIGNED_INT,
+                            (void*)(mesh.firstIndex * sizeof(unsigned int)), particleCount);
+}
+
+// Uploads an RGBA image drawn on the CPU and copies it to the window's
+// framebuffer; both are bottom-up, so no flip or shader is needed
+void presentSoftwareFrame(SoftwareFrame& frame, const uint8_t* pixels, int width, int height, GpuTimer& gpuTimer) {
+    {
+        PROFILE_GPU_SCOPE(gpuTimer, "GPU Upload");
+        uploadSoftwareFrame(frame, pixels, width, height);
+    }
+
+    PROFILE_GPU_SCOPE(gpuTimer, "GPU Blit");
+    blitSoftwareFrame(frame);
+}
+
+// Both leave the read framebuffer as they found it: offscreen rendering reads
+// the video frames back from its own framebuffer, not the default one
+void uploadSoftwareFrame(SoftwareFrame& frame, const uint8_t* pixels, int width, int height) {
+    GLint previous = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+    if (frame.texture == 0) {
+        glGenTextures(1, &frame.texture);
+        glGenFramebuffers(1, &frame.framebuffer);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, frame.framebuffer);
+    glBindTexture(GL_TEXTURE_2D, frame.texture);
+    if (frame.width != width || frame.height != height) {
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, frame.texture, 0);
+        frame.width = width;
+        frame.height = height;
+    } else {
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+    }
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+}
+
+// Part of an image of the frame's size, after a full upload
+void uploadSoftwareFrameRect(SoftwareFrame& frame, const uint32_t* pixels, const PixelRect& rect) {
+    if (frame.texture == 0 || rect.empty()) return;
+    glBindTexture(GL_TEXTURE_2D, frame.texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, frame.width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x0, rect.y0, rect.x1 - rect.x0, rect.y1 - rect.y0, GL_RGBA, GL_UNSIGNED_BYTE,
+                    pixels + static_cast<size_t>(rect.y0) * frame.width + rect.x0);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void blitSoftwareFrame(const SoftwareFrame& frame) {
+    GLint previous = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, frame.framebuffer);
+    glBlitFramebuffer(0, 0, frame.width, frame.height, 0, 0, frame.width, frame.height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, previous);
+}
+
+// Loads the scene (built-in or file), bakes its static part into a distance
+// field and hands out the kinematic colliders; false after printing the error
+bool bakeColliders(const std::string& sceneName, SignedDistanceField& colliders, std::vector<KinematicCollider>& kinematic) {
+    ColliderScene scene;
+    if (!loadColliderScene(sceneName, scene)) {
+        std::cout << "Unknown scene or unreadable scene file: " << sceneName << " (built-in: " << builtinColliderScenes()
+                  << ")" << std::endl;
+        return false;
+    }
+    PROFILE_SCOPE(g_profiler, "Startup: Colliders");
+    colliders.bake(scene, SDF_RESOLUTION);
+    kinematic = scene.kinematic;
+    if (scene.hasStatic()) {
+        std::cout << "Scene: " << scene.name << ", " << scene.segments.size() << " segments, " << scene.polygons.size()
+                  << " polygons baked into a " << SDF_RESOLUTION << "x" << SDF_RESOLUTION << " distance field" << std::endl;
+    }
+    if (!kinematic.empty()) {
+        std::cout << "Scene: " << scene.name << ", " << kinematic.size() << " kinematic colliders" << std::endl;
+    }
+    return true;
+}
+
+void paintColliders(const SignedDistanceField& colliders, int width, int height, std::vector<uint32_t>& pixels) {
+    colliders.paint(width, height, packRgba8(0.3f, 0.35f, 0.45f), packRgba8(0.5f, 0.55f, 0.7f), packRgba8(0.1f, 0.1f, 0.1f), pixels);
+}
+
+// Generates a built-in field or loads a field file; false after printing the error
+bool loadForceField(const std::string& fieldName, ForceField& field) {
+    PROFILE_SCOPE(g_profiler, "Startup: Force Field");
+    if (!field.load(fieldName, FORCE_FIELD_RESOLUTION)) {
+        std::cout << "Unknown force field or unreadable field file: " << fieldName << " (built-in: " << builtinForceFields()
+                  << ")" << std::endl;
+        return false;
+    }
+    if (!field.isEmpty()) {
+        std::cout << "Force field: " << fieldName << ", " << field.getResolution() << "x" << field.getResolution() << " nodes" << std::endl;
+    }
+    return true;
+}
+
+// Event stream with a ring for every thread any pipeline of the run can use,
+// the T key going up to one per hardware thread. Its consumer thread writes
+// "frame i j impulse x y" lines to --events, or only counts without a file.
+std::unique_ptr<CollisionEventStream> startCollisionEvents(const RunOptions& options, const PipelineSpec& startPipeline) {
+    int producers = std::max(resolveThreadCount(0), resolveThreadCount(startPipeline.threads));
+    for (const PipelineSpec& spec : options.abPipelines) producers = std::max(producers, resolveThreadCount(spec.threads));
+    std::unique_ptr<CollisionEventStream> stream(new CollisionEventStream(
+        producers, COLLISION_EVENT_RING_SIZE, options.eventImpulse, std::chrono::microseconds(COLLISION_EVENT_POLL_US)));
+
+    if (options.eventsPath.empty()) {
+        stream->start(CollisionEventStream::Consumer());
+        std::cout << "Collision events: counting impacts above impulse " << options.eventImpulse << std::endl;
+        return stream;
+    }
+    std::shared_ptr<FILE> file(fopen(options.eventsPath.c_str(), "w"), [](FILE* f) { if (f) fclose(f); });
+    if (!file) {
+        std::cout << "Failed to open collision event file: " << options.eventsPath << std::endl;
+        return nullptr;
+    }
+    fprintf(file.get(), "# frame i j impulse x y\n");
+    stream->start([file](const CollisionEvent* events, size_t count) {
+        for (size_t k = 0; k < count; k++) {
+            const CollisionEvent& event = events[k];
+            fprintf(file.get(), "%u %d %d %.4f %.5f %.5f\n", event.frame, event.i, event.j, event.impulse, event.x, event.y);
         }
+    });
+    std::cout << "Collision events: impacts above impulse " << options.eventImpulse << " to " << options.eventsPath << std::endl;
+    return stream;
+}
+
+// Opens --analytics for writing, when given; false after printing the error
+bool openAnalytics(const RunOptions& options, std::shared_ptr<FILE>& file) {
+    if (options.analyticsInterval > 0) {
+        std::cout << "Analytics: every " << options.analyticsInterval << " frames, " << ANALYTICS_CELLS_PER_BIN << "x"
+                  << ANALYTICS_CELLS_PER_BIN << " grid cells per block" << (options.analyticsPath.empty() ? "" : " to ")
+                  << options.analyticsPath << std::endl;
+    }
+    if (options.analyticsPath.empty()) return true;
+    file.reset(fopen(options.analyticsPath.c_str(), "w"), [](FILE* f) { if (f) fclose(f); });
+    if (!file) {
+        std::cout << "Failed to open analytics file: " << options.analyticsPath << std::endl;
+        return false;
     }
+    fprintf(file.get(), "# column row count packing vx vy temperature coordination\n");
+    return true;
 }
 
-void generatePositionsAndStaticData(std::vector<float>& lastPositions, std::vector<float>& positions, std::vector<float>& radiusColorData, std::vector<float>& acceleration) {
+// Every interval frames, on the simulation's pool while it is idle between steps
+void updateAnalytics(GridAnalytics& analytics, SimulationBase& simulation, int interval, FILE* file) {
+    if (interval <= 0 || simulation.getFrame() % interval != 0) return;
+    PROFILE_SCOPE(g_profiler, "Analytics");
+    analytics.compute(simulation.getThreadPool(), simulation.getGrid(), simulation.getWorldPositions(),
+                      simulation.getWorldLastPositions(), simulation.getStepTime(), simulation.getFrame());
+    if (file) analytics.write(file);
+}
 
-    // Randomly generate a position for the new circle
-    static std::random_device rd;  // Obtain a random number from hardware
-    static std::mt19937 eng(rd()); // Seed the generator
-    static std::uniform_real_distribution<float> color(-1.0f, 1.0f); // Random color distribution
+// Starts the --config watcher and the --control socket, both feeding queue;
+// false after printing why one failed
+bool startCommandSources(const RunOptions& options, CommandQueue& queue, std::unique_ptr<ConfigWatcher>& watcher,
+                         std::unique_ptr<ControlSocket>& socket) {
+    if (!options.configPath.empty()) {
+        watcher.reset(new ConfigWatcher(queue, options.configPath, std::chrono::milliseconds(CONFIG_POLL_MS)));
+        if (!watcher->start()) {
+            std::cout << "Failed to read config file: " << options.configPath << std::endl;
+            return false;
+        }
+    }
+    if (!options.controlPath.empty()) {
+        socket.reset(new ControlSocket(queue, options.controlPath));
+        if (!socket->start()) return false;
+        std::cout << "Control socket: " << options.controlPath << std::endl;
+    }
+    return true;
+}
 
-    for(int i = 0; i < NUMBER_OF_CIRCLES_SPAWNED; i++) {
-       
-        positions.push_back(-0.95f); // X position
-        positions.push_back(0.95f - SRC_HEIGHT * (i * radius) * 0.005f); // Y position
-        lastPositions.push_back(-0.95f); // X position
-        lastPositions.push_back(0.95f - SRC_HEIGHT * (i * radius) * 0.005f); // Y position
+// Everything queued since the last frame, in queue order. Spawns without a
+// layout height take the window's, so the text in applied replays exactly.
+void applyCommands(CommandQueue& queue, SimulationBase& simulation, int layoutHeight, std::vector<std::string>& applied) {
+    auto apply = [&](Command command) {
+        if (command.type == CommandType::Spawn && command.layoutHeight == 0) command.layoutHeight = layoutHeight;
+        simulation.applyCommand(command);
+        applied.push_back(formatCommand(command));
+        std::cout << "Command: " << applied.back() << std::endl;
+    };
+    queue.drain(apply);
+}
 
-        acceleration.push_back(0.0f);     // 0 m/s^2 on X
-        acceleration.push_back(-5.0f);    // gravity on Y (increased for visibility)
+// Warmer than the static geometry, so what moves stands out
+const std::vector<PixelRect>& paintKinematicColliders(KinematicLayer& layer, const KinematicColliders& kinematic,
+                                                      const std::vector<uint32_t>& background) {
+    return layer.update(kinematic, background, packRgba8(0.45f, 0.35f, 0.3f), packRgba8(0.75f, 0.6f, 0.45f));
+}
 
+// Radius and color for every particle spawned since the last call
+void appendStaticData(std::vector<float>& radiusColorData, int particleCount) {
+    while (static_cast<int>(radiusColorData.size()) < particleCount * 4) {
         radiusColorData.push_back(radius);
-        radiusColorData.push_back(1.0f); // Random color R
-        radiusColorData.push_back(1.0f); // Random color R
-        radiusColorData.push_back(1.0f);
-
-        // setting up velocity this way we use the formula (xn - x(n-1))/deltaT = v
-        // static method
-        int currentCircleIndex = (positions.size() / 2) - 1; // Get the index of the circle we just added
-        lastPositions[currentCircleIndex * 2] = positions[currentCircleIndex * 2] - velocityX * deltaTime;
-        lastPositions[currentCircleIndex * 2 + 1] = positions[currentCircleIndex * 2 + 1] + velocityY * deltaTime;
+        radiusColorData.push_back(1.0f); // Color R
+        radiusColorData.push_back(1.0f); // Color G
+        radiusColorData.push_back(1.0f); // Color B
     }
 }
 
-void genAndBindBuffers(unsigned int& VAO, unsigned int& positionVBO, unsigned int& radiusColorVBO, std::vector<float>& positions, std::vector<float>& radiusColorData, std::vector<unsigned int>& indices, std::vector<float>& circleVertices){
+void genAndBindBuffers(unsigned int& VAO, unsigned int& positionVBO, unsigned int& lastPositionVBO, unsigned int& radiusColorVBO, std::vector<float>& positions, std::vector<float>& radiusColorData, std::vector<unsigned int>& indices, std::vector<float>& circleVertices){
     unsigned int VBO,  EBO;
 
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
     glGenBuffers(1, &positionVBO);
+    glGenBuffers(1, &lastPositionVBO);
     glGenBuffers(1, &radiusColorVBO);
 
     glBindVertexArray(VAO);
@@ -432,6 +1347,13 @@ void genAndBindBuffers(unsigned int& VAO, unsigned int& positionVBO, unsigned in
     glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(1 * sizeof(float)));
     glEnableVertexAttribArray(3);
     glVertexAttribDivisor(3, 1); // This makes it instanced
+
+    // Previous positions for speed coloring (location 4), uploaded with the positions
+    glBindBuffer(GL_ARRAY_BUFFER, lastPositionVBO);
+    glBufferData(GL_ARRAY_BUFFER, NUMCIRCLES * 2 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glVertexAttribPointer(4, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1); // This makes it instanced
 }
 
 int initWindow(GLFWwindow *window){
@@ -448,45 +1370,54 @@ int initWindow(GLFWwindow *window){
     // Enable V-Sync to limit to monitor refresh rate (usually 60 FPS)
     glfwSwapInterval(0);  // 1 = enable V-Sync, 0 = disable
 
-    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
-        std::cout << "Failed to initialize GLAD" << std::endl;
-        return -1;
-    }  
+    {
+        PROFILE_SCOPE(g_profiler, "Startup: GLAD Load");
+        if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
+            std::cout << "Failed to initialize GLAD" << std::endl;
+            return -1;
+        }
+    }
 
     // sets the viewport to the size of the window
     glViewport(0, 0, SRC_WIDTH, SRC_HEIGHT);
 
     // resizes the viewport when the window is resized
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback); 
-
-    glClearColor(0.1f, 0.1f, 0.1f, 1.0f); // RGBA values
     return 0;
 }
 
-void creatingCircles(std::vector<float>& circleVertices, std::vector<unsigned int>& indices){
+void creatingCircles(std::vector<float>& circleVertices, std::vector<unsigned int>& indices, std::vector<CircleLod>& circleLods){
 
+    // Every LOD is appended to the same vertex and element buffers
+    for (int segments : CIRCLE_LOD_SEGMENTS) {
+        unsigned int center = circleVertices.size() / 3;
+        CircleLod lod;
+        lod.firstIndex = indices.size();
 
-    // Center vertex
-    circleVertices.push_back(0.0f);
-    circleVertices.push_back(0.0f);
-    circleVertices.push_back(0.0f);
-    
-    // Generate vertices around the circle
-    for (int i = 0; i <= segments; i++) {
-        float angle = 2.0f * M_PI * i / segments;
-        circleVertices.push_back(cos(angle));
-        circleVertices.push_back(sin(angle));
+        // Center vertex
+        circleVertices.push_back(0.0f);
+        circleVertices.push_back(0.0f);
         circleVertices.push_back(0.0f);
-    }
 
-    for (int i = 1; i <= segments; i++) {
-        indices.push_back(0);      // center
-        indices.push_back(i);      // current vertex
-        indices.push_back(i + 1);  // next vertex
-    }
-    // Close the circle
-    indices[indices.size() - 1] = 1;
+        // Generate vertices around the circle
+        for (int i = 0; i <= segments; i++) {
+            float angle = 2.0f * M_PI * i / segments;
+            circleVertices.push_back(cos(angle));
+            circleVertices.push_back(sin(angle));
+            circleVertices.push_back(0.0f);
+        }
 
+        for (int i = 1; i <= segments; i++) {
+            indices.push_back(center);          // center
+            indices.push_back(center + i);      // current vertex
+            indices.push_back(center + i + 1);  // next vertex
+        }
+        // Close the circle
+        indices[indices.size() - 1] = center + 1;
+
+        lod.indexCount = indices.size() - lod.firstIndex;
+        circleLods.push_back(lod);
+    }
 }
 
 int creatingVertexShader(unsigned int vertexShader){
@@ -528,6 +1459,8 @@ int creatingShaderProgram(unsigned int shaderProgram, unsigned int fragmentShade
     shaderProgram = glCreateProgram();
     glAttachShader(shaderProgram, vertexShader);
     glAttachShader(shaderProgram, fragmentShader);
+    // Lets ShaderCache read the linked binary back
+    if (glProgramParameteri) glProgramParameteri(shaderProgram, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
     glLinkProgram(shaderProgram);
 
 
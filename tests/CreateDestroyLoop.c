@@ -0,0 +1,30 @@
+/* Creates, steps and destroys simulations through the C API well past the
+ * point where the arena would run out if destroyed simulations leaked
+ * their storage. */
+#include "ParticleSimApi.h"
+#include <stdio.h>
+
+#define ITERATIONS 300
+#define FRAMES 30
+
+int main(void) {
+    psim_config config;
+    psim_config_defaults(&config);
+    config.seed = 42;
+    config.threads = 1;
+    for (int iteration = 0; iteration < ITERATIONS; iteration++) {
+        psim_simulation* simulation = psim_create(&config);
+        if (!simulation) {
+            printf("psim_create failed at iteration %d: %s\n", iteration, psim_last_error());
+            return 1;
+        }
+        if (psim_step(simulation, FRAMES) != PSIM_OK) {
+            printf("psim_step failed at iteration %d: %s\n", iteration, psim_last_error());
+            psim_destroy(simulation);
+            return 1;
+        }
+        psim_destroy(simulation);
+    }
+    printf("%d simulations created, stepped and destroyed\n", ITERATIONS);
+    return 0;
+}